@@ -1,4 +1,4 @@
-#include "domino.h"
+#include "Domino.h"
 
 DominoApp::DominoApp() :
 RigidBodyApplication()
@@ -26,12 +26,13 @@ RigidBodyApplication()
 
 	for (int i = 0; i < SPHERE_NUM; i++)
 	{
-		sphere_bodies[i] = RigidBody(sphereStackPosition + Vector2(0, (real)(i) * sphereRadius * 2),
+		sphere_bodies[i] = RigidBody(world.getBodyStore(),
+			sphereStackPosition + Vector2(0, (real)(i) * sphereRadius * 2),
 			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
 	}
 	for (int i = 0; i < BOX_NUM; i++)
 	{
-		box_bodies[i] = RigidBody(boxStackPosition + boxStackGap * i,
+		box_bodies[i] = RigidBody(world.getBodyStore(), boxStackPosition + boxStackGap * i,
 			Vector2(0.0, 1.0), 1.0f / boxMass, 1.0f / boxMOI);
 	}
 
@@ -41,6 +42,13 @@ RigidBodyApplication()
 	for (int i = 0; i < BOX_NUM; i++)
 		boxes[i] = CollisionBox(&box_bodies[i], boxHalfSize);
 
+	for (int i = 0; i < SPHERE_NUM; i++)
+		collisionSpace.add(&spheres[i]);
+	for (int i = 0; i < BOX_NUM; i++)
+		collisionSpace.add(&boxes[i]);
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
 
 	// assign to world
 	for (int i = 0; i < SPHERE_NUM; i++)
@@ -60,26 +68,7 @@ RigidBodyApplication()
 void DominoApp::generateContacts()
 {
 	collisionData.reset();
-
-	for (int i = 0; i < SPHERE_NUM; i++)
-		for (int j = i + 1; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndSphere(spheres[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = i + 1; j < BOX_NUM; j++)
-			CollisionDetector::boxAndBox2(boxes[i], boxes[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::boxAndSphere(boxes[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < PLANE_NUM; i++)
-	{
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndHalfSpace(spheres[j], planes[i], &collisionData);
-		for (int j = 0; j < BOX_NUM; j++)
-			CollisionDetector::boxAndHalfSpace(boxes[j], planes[i], &collisionData);
-	}
+	collisionSpace.generateContacts(&collisionData);
 }
 
 void DominoApp::display()
@@ -80,28 +80,91 @@ collisionData(MAX_CONTACT, 0.4, 0.5),
 resolver(MAX_CONTACT, MAX_CONTACT, -0.0, -0.0)
 {
 	RigidBody::setSleepEpsilon(0.001);
+	world.setIslandSleep(true);
+	resolver.setIslands(true);
+	world.getResolver().setIslands(true);
 	collisionData.reset();
+	contactCount = 0;
+	substeps = ITERATION;
 }
 
+RigidBodyApplication::~RigidBodyApplication()
+{}
+
 void RigidBodyApplication::updateForce(real duration)
 {}
 
 void RigidBodyApplication::update(real duration)
 {
-	for (int i = 0; i < ITERATION; i++)
+	PROFILE_FRAME();
+	contactCount = 0;
+	for (int i = 0; i < substeps; i++)
 	{
 		world.startFrame();
-		updateForce(duration / ITERATION);
-		world.runPhysics(duration / ITERATION);
-
-		generateContacts();
-		resolver.setIterations(collisionData.contactsCount * 2, collisionData.contactsCount * 2);
+		{
+			PROFILE_SCOPE(PROFILE_UPDATE_FORCES);
+			updateForce(duration / substeps);
+		}
+		collisionSpace.storeBulletPoses();
+		world.runPhysics(duration / substeps);
+
+		{
+			PROFILE_SCOPE(PROFILE_APP_CONTACTS);
+			collisionSpace.sweepBullets();
+			generateContacts();
+		}
+		if (resolver.getMode() == RESOLVE_WORST_FIRST)
+			resolver.setIterations(collisionData.contactsCount * 2, collisionData.contactsCount * 2);
 		resolver.resolveContacts(collisionData.contactArray,
 			collisionData.contactsCount, duration);
+		contactCount += world.getUsedContacts() + collisionData.contactsCount;
+		world.updateSleep(collisionData.contactArray, collisionData.contactsCount);
 		//std::cout << collisionData.contactsCount << "\n";
 	}
 }
 
+World& RigidBodyApplication::getWorld()
+{
+	return world;
+}
+
+ContactResolver& RigidBodyApplication::getResolver()
+{
+	return resolver;
+}
+
+void RigidBodyApplication::setJobSystem(JobSystem *jobs)
+{
+	resolver.setJobSystem(jobs);
+	world.getResolver().setJobSystem(jobs);
+}
+
+CollisionSpace& RigidBodyApplication::getCollisionSpace()
+{
+	return collisionSpace;
+}
+
+CollisionData& RigidBodyApplication::getCollisionData()
+{
+	return collisionData;
+}
+
+int RigidBodyApplication::getContactCount() const
+{
+	return contactCount;
+}
+
+int RigidBodyApplication::getSubsteps() const
+{
+	return substeps;
+}
+
+void RigidBodyApplication::setSubsteps(int substeps)
+{
+	assert(substeps > 0);
+	this->substeps = substeps;
+}
+
 void RigidBodyApplication::keyboard(unsigned char key)
 {
 	switch (key)
@@ -130,3 +193,18 @@ real RigidBodyApplication::boixMOIPerMass(const Vector2& halfsize)
 	return 1.0 / 3 *(halfsize.x * halfsize.x + halfsize.y * halfsize.y);
 }
 
+real RigidBodyApplication::polygonMOIPerMass(const Vector2 *vertices, int count)
+{
+	// sum over the triangles (origin, a, b), weighted by their area
+	real numerator = 0;
+	real denominator = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const Vector2 &a = vertices[i];
+		const Vector2 &b = vertices[(i + 1) % count];
+		real cross = a.x * b.y - a.y * b.x;
+		numerator += cross * (a * a + a * b + b * b);
+		denominator += cross;
+	}
+	return numerator / (6 * denominator);
+}
@@ -1,8 +1,6 @@
 #ifndef __APP_H_INCLUDED__
 #define __APP_H_INCLUDED__
 
-#include <windows.h>
-#include <GL/glut.h>
 #include <iostream>
 
 #include "precision.h"
@@ -53,10 +51,11 @@ public:
 
 class RigidBodyApplication
 {
-protected:
+public:
 	static const int MAX_CONTACT = 10000;
 	static const int ITERATION = 4;
 
+protected:
 	World world;
 
 	Gravity gravity;
@@ -64,22 +63,41 @@ protected:
 	Field field;
 
 	CollisionData collisionData;
+	CollisionSpace collisionSpace;
 	ContactResolver resolver;
 
+	int contactCount; // contacts resolved over all substeps of the last update
+	int substeps; // per update, ITERATION by default
+
 protected:
 	virtual void generateContacts() = 0;
 
 public:
 	RigidBodyApplication();
+	virtual ~RigidBodyApplication();
 	virtual void updateForce(real duration);
 	virtual void update(real duration);
 	virtual void display() = 0;
 
+	// accessor
+	World& getWorld();
+	ContactResolver& getResolver();
+	CollisionSpace& getCollisionSpace();
+	CollisionData& getCollisionData(); // contacts of the last substep
+	int getContactCount() const;
+	int getSubsteps() const;
+	void setSubsteps(int substeps);
+	// resolves the islands of the app's and the world's contacts in
+	// parallel, NULL for single threaded
+	virtual void setJobSystem(JobSystem *jobs);
+
 	virtual void passiveMotion(const Vector2& position);
 	virtual void keyboard(unsigned char key);
 
 	static real sphereMOIPerMass(real radius);
 	static real boixMOIPerMass(const Vector2& halfsize);
+	// about the origin, vertices counter-clockwise
+	static real polygonMOIPerMass(const Vector2 *vertices, int count);
 };
 
 
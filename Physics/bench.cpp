@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "profile.h"
+#include "jobs.h"
+#include "app.h"
+#include "sandBox.h"
+#include "car.h"
+#include "Domino.h"
+#include "cradle.h"
+#include "pool.h"
+#include "bridge.h"
+#include "curtain.h"
+#include "piston.h"
+#include "hull.h"
+#include "nbody.h"
+#include "psystem.h"
+
+// Headless benchmark: builds each demo scene without a window and steps
+// RigidBodyApplication::update at a fixed timestep. threads > 1 resolves
+// the contact islands on a JobSystem (0 for one thread per core). The
+// particles scene steps a ParticleSystem of a million particles under
+// gravity and drag.
+// physics_bench_float is the same program built with real = float.
+//
+// usage: physics_bench [steps] [dt] [scene|all] [hash|tree|sap] [worst|pgs] [threads]
+
+struct Scene
+{
+	const char* name;
+	RigidBodyApplication* (*create)();
+	bool kick; // press ' ' once before stepping, as in the demo
+};
+
+template<class App>
+static RigidBodyApplication* createScene()
+{
+	return new App;
+}
+
+// hull as crossed boxes, to compare with the polygons
+static RigidBodyApplication* createHullBoxes()
+{
+	return new HullApp(true);
+}
+
+// mutual gravity summed over every pair, to compare with the quadtree
+static RigidBodyApplication* createNBodyExact()
+{
+	return new NBodyApp(true);
+}
+
+static const Scene SCENES[] =
+{
+	{ "sandbox", createScene<SandBoxApp>, false },
+	{ "car", createScene<CarApp>, true },
+	{ "cradle", createScene<CradleApp>, true },
+	{ "domino", createScene<DominoApp>, false },
+	{ "pool", createScene<PoolApp>, true },
+	{ "bridge", createScene<BridgeApp>, false },
+	{ "curtain", createScene<CurtainApp>, true },
+	{ "piston", createScene<PistonApp>, true },
+	{ "hull", createScene<HullApp>, false },
+	{ "hull-boxes", createHullBoxes, false },
+	{ "nbody", createScene<NBodyApp>, false },
+	{ "nbody-exact", createNBodyExact, false },
+};
+static const int SCENE_NUM = sizeof(SCENES) / sizeof(SCENES[0]);
+
+// sweeps per resolve in the sequential impulse mode
+static const int SEQUENTIAL_VELOCITY_ITERATIONS = 8;
+static const int SEQUENTIAL_POSITION_ITERATIONS = 4;
+
+#ifdef PHYSICS_PROFILE
+// average of the last Profiler::HISTORY_SIZE steps
+static void printProfile()
+{
+	ProfileFrame average = Profiler::get().getAverage();
+	for (int p = 0; p < PROFILE_PHASE_NUM; p++)
+		printf("    %-18s %12lld ns\n", Profiler::getPhaseName((ProfilePhase)p),
+			average.phaseTime[p]);
+	printf("    %-18s %12d\n", "contacts", average.contacts);
+	printf("    %-18s %12d / %d\n", "iterations used", average.positionIterationUsed,
+		average.velocityIterationUsed);
+}
+#endif
+
+static void runScene(const Scene &scene, int steps, real dt, Broadphase *broadphase,
+	bool sequentialImpulse, JobSystem *jobs)
+{
+	RigidBodyApplication* app = scene.create();
+	app->getCollisionSpace().setBroadphase(broadphase);
+	app->setJobSystem(jobs);
+	if (sequentialImpulse)
+	{
+		ContactResolver* resolvers[2] = { &app->getResolver(), &app->getWorld().getResolver() };
+		for (int i = 0; i < 2; i++)
+		{
+			resolvers[i]->setMode(RESOLVE_SEQUENTIAL_IMPULSE);
+			resolvers[i]->setIterations(SEQUENTIAL_VELOCITY_ITERATIONS,
+				SEQUENTIAL_POSITION_ITERATIONS);
+		}
+	}
+	if (scene.kick)
+		app->keyboard(' ');
+
+	int bodies = (int)app->getWorld().getRigidBodies().size();
+	long long contacts = 0;
+	Profiler::get().clear();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++)
+	{
+		app->update(dt);
+		contacts += app->getContactCount();
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	double stepsPerSecond = steps / (ns * 1e-9);
+	double nsPerBodyStep = ns / ((double)steps * bodies);
+	double contactsPerStep = (double)contacts / steps;
+
+	printf("%-10s %8d %8d %8d %12.1f %14.1f %14.1f\n", scene.name, bodies, steps,
+		app->getSubsteps(), stepsPerSecond, nsPerBodyStep, contactsPerStep);
+#ifdef PHYSICS_PROFILE
+	printProfile();
+#endif
+	delete app;
+}
+
+static const int PARTICLE_NUM = 1000000;
+
+static void runParticles(int steps, real dt, JobSystem *jobs)
+{
+	ParticleGravity gravity(Vector2(0, -0.4));
+	ParticleDrag drag(0.2, 0.2);
+	ParticleSystem system;
+	system.setJobSystem(jobs);
+	system.addForceGenerator(&gravity);
+	system.addForceGenerator(&drag);
+
+	// a 1000 x 1000 grid, fanned out
+	system.reserve(PARTICLE_NUM);
+	for (int i = 0; i < PARTICLE_NUM; i++)
+	{
+		int row = i / 1000, column = i % 1000;
+		int index = system.add(Vector2((real)column / 500 - 1, (real)row / 500 - 1), 1);
+		system.applyImpulse(index, Vector2((real)(column - 500) / 500, (real)row / 1000));
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++)
+		system.runPhysics(dt);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	printf("%-10s %8d %8d %8d %12.1f %14.2f %14.1f\n", "particles", PARTICLE_NUM, steps, 1,
+		steps / (ns * 1e-9), ns / ((double)steps * PARTICLE_NUM), 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+	int steps = 1000;
+	real dt = (real)1.0 / 60;
+	const char* only = NULL;
+	const char* broadphaseName = "hash";
+	const char* resolverName = "worst";
+	int threads = 1;
+
+	if (argc > 1)
+		steps = atoi(argv[1]);
+	if (argc > 2)
+		dt = (real)atof(argv[2]);
+	if (argc > 3 && strcmp(argv[3], "all") != 0)
+		only = argv[3];
+	if (argc > 4)
+		broadphaseName = argv[4];
+	if (argc > 5)
+		resolverName = argv[5];
+	if (argc > 6)
+		threads = atoi(argv[6]);
+
+	SpatialHash spatialHash;
+	BVHTree tree;
+	SweepAndPrune sweepAndPrune;
+	Broadphase* broadphase = NULL;
+	if (strcmp(broadphaseName, "hash") == 0)
+		broadphase = &spatialHash;
+	else if (strcmp(broadphaseName, "tree") == 0)
+		broadphase = &tree;
+	else if (strcmp(broadphaseName, "sap") == 0)
+		broadphase = &sweepAndPrune;
+
+	bool sequentialImpulse = (strcmp(resolverName, "pgs") == 0);
+	bool knownResolver = sequentialImpulse || strcmp(resolverName, "worst") == 0;
+
+	if (steps <= 0 || dt <= 0 || broadphase == NULL || !knownResolver || threads < 0)
+	{
+		fprintf(stderr, "usage: %s [steps] [dt] [scene|all] [hash|tree|sap] [worst|pgs] [threads]\n", argv[0]);
+		return 1;
+	}
+
+	JobSystem jobs(threads);
+
+	printf("steps = %d, dt = %f, broadphase = %s, resolver = %s, threads = %d, "
+		"real = %s\n", steps, (double)dt, broadphaseName,
+		resolverName, jobs.getThreadCount(), sizeof(real) == sizeof(float) ? "float" : "double");
+	printf("%-10s %8s %8s %8s %12s %14s %14s\n", "scene", "bodies", "steps", "substeps",
+		"steps/s", "ns/body-step", "contacts/step");
+
+	bool found = false;
+	for (int i = 0; i < SCENE_NUM; i++)
+	{
+		if (only != NULL && strcmp(only, SCENES[i].name) != 0)
+			continue;
+		// fresh persistent state per scene, the indices belong to the previous one
+		tree.clear();
+		sweepAndPrune.clear();
+		runScene(SCENES[i], steps, dt, broadphase, sequentialImpulse, &jobs);
+		found = true;
+	}
+
+	if (only == NULL || strcmp(only, "particles") == 0)
+	{
+		runParticles(steps, dt, &jobs);
+		found = true;
+	}
+
+	if (!found)
+	{
+		fprintf(stderr, "unknown scene: %s\n", only);
+		return 1;
+	}
+	return 0;
+}
@@ -1,233 +1,297 @@
+#include <assert.h>
+
 #include "body.h"
 
 real RigidBody::sleepEpsilon = 0;
 
 RigidBody::RigidBody()
-	: orientation(1, 0)
 {
-	angularVelocity = 0;
-	inverseMass = 1;
-	inverseMomentOfInertia = 1;
-	linearDamping = (real)0.99;
-	angularDamping = (real)0.99;
-	torqueAccum = 0;
-
-	motion = 10 * sleepEpsilon;
-	isAwake = false;
-	canSleep = true;
-	calculateDerivedData();
+	store = NULL;
+	handle.index = 0;
+	handle.generation = 0;
 }
 
-RigidBody::RigidBody(const Vector2 &position, const Vector2 &orientation,
-	real inverseMass, real inverseMomentOfInertia)
-	: orientation(1, 0)
+RigidBody::RigidBody(BodyStore &store, const Vector2 &position,
+	const Vector2 &orientation, real inverseMass, real inverseMomentOfInertia)
 {
-	this->position = position;
+	this->store = &store;
+	handle = store.create();
+	store.setPosition(handle.index, position);
 	if (orientation.magnitude() > 0)
-		this->orientation = orientation;
-	this->inverseMass = inverseMass;
-	this->inverseMomentOfInertia = inverseMomentOfInertia;
-	angularVelocity = 0;
-	linearDamping = (real)0.99;
-	angularDamping = (real)0.99;
-	torqueAccum = 0;
+		store.setOrientation(handle.index, orientation);
+	store.inverseMass[handle.index] = inverseMass;
+	store.inverseMomentOfInertia[handle.index] = inverseMomentOfInertia;
+	store.calculateDerivedData(handle.index);
+}
+
+RigidBody::RigidBody(const RigidBody &other)
+{
+	store = other.store;
+	handle.index = 0;
+	handle.generation = 0;
+	if (store != NULL)
+	{
+		handle = store->create();
+		store->copy(other.handle.index, handle.index);
+	}
+}
+
+RigidBody& RigidBody::operator=(const RigidBody &other)
+{
+	if (this == &other)
+		return *this;
 
-	motion = 10 * sleepEpsilon;
-	isAwake = false;
-	canSleep = true;
-	calculateDerivedData();
+	// a body moving to another store gives up its slot in the old one
+	if (store != other.store)
+	{
+		if (store != NULL)
+			store->destroy(handle);
+		store = other.store;
+		if (store != NULL)
+			handle = store->create();
+	}
+	if (store != NULL)
+		store->copy(other.handle.index, handle.index);
+	return *this;
+}
+
+RigidBody::~RigidBody()
+{
+	if (store != NULL)
+		store->destroy(handle);
+}
+
+BodyStore* RigidBody::getStore() const
+{
+	return store;
+}
+
+BodyHandle RigidBody::getHandle() const
+{
+	return handle;
 }
 
 Vector2 RigidBody::getPosition() const
 {
-	return position;
+	assert(store != NULL);
+	return store->getPosition(handle.index);
 }
 
 Vector2 RigidBody::getOrientation() const
 {
-	return orientation;
+	assert(store != NULL);
+	return store->getOrientation(handle.index);
 }
 
 Vector2 RigidBody::getVelocity() const
 {
-	return velocity;
+	assert(store != NULL);
+	return store->getVelocity(handle.index);
 }
 
 real RigidBody::getAngularVelocity() const
 {
-	return angularVelocity;
+	assert(store != NULL);
+	return store->angularVelocity[handle.index];
 }
 
 Vector2 RigidBody::getAcceleration() const
 {
-	return acceleration;
+	assert(store != NULL);
+	return store->getAcceleration(handle.index);
 }
 
 Matrix3 RigidBody::getTransformMatrix() const
 {
-	return transformMatrix;
+	assert(store != NULL);
+	return store->transformMatrix[handle.index];
 }
 
 real RigidBody::getInverseMass() const
 {
-	return inverseMass;
+	assert(store != NULL);
+	return store->inverseMass[handle.index];
 }
 
 real RigidBody::getMass() const
 {
-	if (inverseMass == 0)
+	assert(store != NULL);
+	if (store->inverseMass[handle.index] == 0)
 		return 0;
 
-	return 1.0f / inverseMass;
+	return 1.0f / store->inverseMass[handle.index];
 }
 
 real RigidBody::getInverseMomentOfInertia() const
 {
-	return inverseMomentOfInertia;
+	assert(store != NULL);
+	return store->inverseMomentOfInertia[handle.index];
 }
 
 bool RigidBody::getIsAwake() const
 {
-	return isAwake;
+	assert(store != NULL);
+	return store->isAwake[handle.index];
+}
+
+bool RigidBody::getCanSleep() const
+{
+	assert(store != NULL);
+	return store->canSleep[handle.index];
+}
+
+bool RigidBody::getIsBullet() const
+{
+	assert(store != NULL);
+	return store->isBullet[handle.index];
+}
+
+real RigidBody::getMotion() const
+{
+	assert(store != NULL);
+	return store->motion[handle.index];
 }
 
 void RigidBody::calculateDerivedData()
 {
-	orientation.normalize();
-	transformMatrix.setOrientationAndPos(orientation, position);
+	assert(store != NULL);
+	store->calculateDerivedData(handle.index);
 }
 
 void RigidBody::addForce(const Vector2 &force)
 {
-	forceAccum.add(force);
-	isAwake = true;
+	assert(store != NULL);
+	store->forceX[handle.index] += force.x;
+	store->forceY[handle.index] += force.y;
+	store->isAwake[handle.index] = true;
 }
 
 void RigidBody::integrate(real duration)
 {
-	if (!isAwake)
-		return;
-
-	// a = f / m
-	acceleration = forceAccum * inverseMass;
-	real angularAcceleration = torqueAccum * inverseMomentOfInertia;
-	// v = v + a*t
-	velocity.addScaledVector(acceleration, duration);
-	angularVelocity += angularAcceleration * duration;
-	// v = v * d^t
-	velocity.scale(real_pow(linearDamping, duration));
-	angularVelocity *= real_pow(angularDamping, duration);
-	// p = p + v*t     + (1/2 * a*t^2) ~ 0
-	position.add(velocity * duration);
-	position.add(acceleration * (duration * duration / 2));
-	orientation.rotate(angularVelocity * duration);
-	orientation.rotate(angularAcceleration * (duration * duration / 2));
-
-	calculateDerivedData();
-	clearAccumulators();
-
-	if (canSleep)
-	{
-		const real baseBias = 0.5f;
-		real currentMotion = velocity * velocity + angularVelocity * angularVelocity;
-		real bias = real_pow(baseBias, duration);
-		motion = bias * motion + (1 - bias) * currentMotion;
-
-		if (motion < sleepEpsilon)
-			setAwake(false);
-		else if (motion > 10 * sleepEpsilon)
-			motion = 10 * sleepEpsilon;
-	}
+	assert(store != NULL);
+	store->integrate(&handle.index, 1, duration);
 }
 
 void RigidBody::clearAccumulators()
 {
-	forceAccum.clear();
-	torqueAccum = 0;
+	assert(store != NULL);
+	store->forceX[handle.index] = 0;
+	store->forceY[handle.index] = 0;
+	store->torqueAccum[handle.index] = 0;
 }
 
 Vector2 RigidBody::getPointInWorldSpace(const Vector2 &point)
 {
-	return (transformMatrix * point);
+	assert(store != NULL);
+	return (store->transformMatrix[handle.index] * point);
 }
 
 Vector2 RigidBody::getPointInLocalSpace(const Vector2 &point)
 {
-	return (transformMatrix.transformInverse(point));
+	assert(store != NULL);
+	return (store->transformMatrix[handle.index].transformInverse(point));
 }
 
 void RigidBody::addForceAtBodyPoint(const Vector2 &force, const Vector2 &point)
 {
-	Vector2 world = transformMatrix * point;
+	assert(store != NULL);
+	Vector2 world = store->transformMatrix[handle.index] * point;
 	addForceAtPoint(force, world);
-	isAwake = true;
+	store->isAwake[handle.index] = true;
 }
 
 void RigidBody::addForceAtPoint(const Vector2 &force, const Vector2 &point)
 {
-	Vector2 arm = point - position;
-	forceAccum.add(force);
-	torqueAccum += arm.crossProduct(force);
-	isAwake = true;
+	assert(store != NULL);
+	Vector2 arm = point - store->getPosition(handle.index);
+	store->forceX[handle.index] += force.x;
+	store->forceY[handle.index] += force.y;
+	store->torqueAccum[handle.index] += arm.crossProduct(force);
+	store->isAwake[handle.index] = true;
 }
 
 void RigidBody::applyImpulseAtPoint(const Vector2& impulse, const Vector2 &point)
 {
+	assert(store != NULL);
+	unsigned i = handle.index;
 	// linear
-	Vector2 deltaLinearVelocity = impulse *  inverseMass;
-	velocity.add(deltaLinearVelocity);
+	Vector2 deltaLinearVelocity = impulse *  store->inverseMass[i];
+	store->velocityX[i] += deltaLinearVelocity.x;
+	store->velocityY[i] += deltaLinearVelocity.y;
 	// angular
-	real deltaAngularVelocity = -(impulse.crossProduct(point - position)) * inverseMomentOfInertia;
-	angularVelocity += deltaAngularVelocity;
-	isAwake = true;
+	real deltaAngularVelocity = -(impulse.crossProduct(point - store->getPosition(i))) * store->inverseMomentOfInertia[i];
+	store->angularVelocity[i] += deltaAngularVelocity;
+	store->isAwake[i] = true;
 }
 
 bool RigidBody::isFiniteMass() const
 {
-	return (inverseMass > 0);
+	assert(store != NULL);
+	return (store->inverseMass[handle.index] > 0);
+}
+
+bool RigidBody::isMovable() const
+{
+	assert(store != NULL);
+	return (store->inverseMass[handle.index] > 0 ||
+		store->inverseMomentOfInertia[handle.index] > 0);
 }
 
 void RigidBody::applyTorque(real torque)
 {
-	torqueAccum += torque;
-	isAwake = true;
+	assert(store != NULL);
+	store->torqueAccum[handle.index] += torque;
+	store->isAwake[handle.index] = true;
 }
 
 Vector2 RigidBody::getVelocityAtPoint(const Vector2 &point)
 {
+	assert(store != NULL);
+	unsigned i = handle.index;
 	// v = theta_dot.cross(r);
-	Vector2 rotVelLocal = point.crossProduct(-point.magnitude() * angularVelocity);
-	Vector2 rotVelWorld = transformMatrix.transformDirection(rotVelLocal);
-	return velocity + rotVelWorld;
+	Vector2 rotVelLocal = point.crossProduct(-point.magnitude() * store->angularVelocity[i]);
+	Vector2 rotVelWorld = store->transformMatrix[i].transformDirection(rotVelLocal);
+	return store->getVelocity(i) + rotVelWorld;
 }
 
 void RigidBody::move(const Vector2& displacement)
 {
-	position.add(displacement);
+	assert(store != NULL);
+	store->positionX[handle.index] += displacement.x;
+	store->positionY[handle.index] += displacement.y;
 }
 
 void RigidBody::rotate(real rotation)
 {
+	assert(store != NULL);
+	Vector2 orientation = store->getOrientation(handle.index);
 	orientation.rotate(rotation);
+	store->setOrientation(handle.index, orientation);
 }
 
 void RigidBody::setAwake(const bool awake)
 {
-	
+	assert(store != NULL);
 	if (awake)
 	{
-		isAwake = true;
-		motion = sleepEpsilon * 2.0f;
+		store->isAwake[handle.index] = true;
+		store->motion[handle.index] = sleepEpsilon * 2.0f;
 	}
 	else
 	{
-		isAwake = false;
-		velocity.clear();
-		angularVelocity = 0;
+		store->isAwake[handle.index] = false;
+		store->setVelocity(handle.index, Vector2());
+		store->angularVelocity[handle.index] = 0;
 	}
 }
 
+void RigidBody::setBullet(const bool bullet)
+{
+	assert(store != NULL);
+	store->isBullet[handle.index] = bullet;
+}
+
 void RigidBody::setSleepEpsilon(real sleepEpsilon)
 {
 	RigidBody::sleepEpsilon = sleepEpsilon;
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 
 #include "precision.h"
 #include "core.h"
+#include "bodystore.h"
 
 class RigidBody
 {
@@ -11,29 +12,24 @@ public:
 	static real sleepEpsilon;
 
 protected:
-	Vector2 position; // position of center of mass
-	Vector2 orientation;
-	Vector2 velocity;
-	real angularVelocity;
-	Vector2 acceleration;
-	Matrix3 transformMatrix; // only rotation and translation
-	real inverseMass;
-	real inverseMomentOfInertia;
-	real linearDamping; // 0 to 1
-	real angularDamping; // 0 to 1
-	Vector2 forceAccum;
-	real torqueAccum;
-
-	real motion;
-	bool isAwake;
-	bool canSleep;
+	// the state lives in the columns of its world's BodyStore; copies get
+	// their own slot in the same store
+	BodyStore *store;
+	BodyHandle handle;
 
 public:
+	// no slot yet, and nothing but assignment may be used until a bound
+	// body is assigned to it, which gives it a slot in that body's store
 	RigidBody();
-	RigidBody(const Vector2 &position, const Vector2 &orientation,
+	RigidBody(BodyStore &store, const Vector2 &position, const Vector2 &orientation,
 		real inverseMass, real inverseMomentOfInertia);
+	RigidBody(const RigidBody &other);
+	RigidBody& operator=(const RigidBody &other);
+	~RigidBody();
 
 	// accessors
+	BodyStore* getStore() const;
+	BodyHandle getHandle() const;
 	Vector2 getPosition() const;
 	Vector2 getOrientation() const;
 	Vector2 getVelocity() const;
@@ -44,6 +40,9 @@ public:
 	real getMass() const;
 	real getInverseMomentOfInertia() const;
 	bool getIsAwake() const;
+	bool getCanSleep() const;
+	bool getIsBullet() const;
+	real getMotion() const;
 
 	Vector2 getPointInWorldSpace(const Vector2 &point);
 	Vector2 getPointInLocalSpace(const Vector2 &point);
@@ -58,6 +57,7 @@ public:
 	void addForceAtPoint(const Vector2 &force, const Vector2 &point);
 	void applyImpulseAtPoint(const Vector2& impulse, const Vector2 &point);
 	bool isFiniteMass() const;
+	bool isMovable() const; // finite mass or finite moment of inertia
 	void applyTorque(real torque);
 
 	Vector2 getVelocityAtPoint(const Vector2 &point);
@@ -65,6 +65,8 @@ public:
 	void rotate(real rotation);
 
 	void setAwake(const bool awake = true);
+	// fast body, kept from passing through others by continuous collision
+	void setBullet(const bool bullet = true);
 	static void setSleepEpsilon(real sleepEpsilon);
 };
 
@@ -0,0 +1,326 @@
+#include "bodystore.h"
+#include "body.h"
+#include "simd.h"
+
+BodyStore::BodyStore()
+{
+	count = 0;
+	islandSleep = false;
+}
+
+BodyHandle BodyStore::create()
+{
+	unsigned index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = (unsigned)generation.size();
+		generation.push_back(0);
+		positionX.push_back(0);
+		positionY.push_back(0);
+		orientationX.push_back(0);
+		orientationY.push_back(0);
+		velocityX.push_back(0);
+		velocityY.push_back(0);
+		angularVelocity.push_back(0);
+		inverseMass.push_back(0);
+		inverseMomentOfInertia.push_back(0);
+		isAwake.push_back(0);
+		accelerationX.push_back(0);
+		accelerationY.push_back(0);
+		forceX.push_back(0);
+		forceY.push_back(0);
+		torqueAccum.push_back(0);
+		linearDamping.push_back(0);
+		angularDamping.push_back(0);
+		motion.push_back(0);
+		canSleep.push_back(0);
+		isBullet.push_back(0);
+		transformMatrix.push_back(Matrix3());
+	}
+
+	setPosition(index, Vector2());
+	setOrientation(index, Vector2(1, 0));
+	setVelocity(index, Vector2());
+	angularVelocity[index] = 0;
+	inverseMass[index] = 1;
+	inverseMomentOfInertia[index] = 1;
+	isAwake[index] = false;
+	accelerationX[index] = 0;
+	accelerationY[index] = 0;
+	forceX[index] = 0;
+	forceY[index] = 0;
+	torqueAccum[index] = 0;
+	linearDamping[index] = (real)0.99;
+	angularDamping[index] = (real)0.99;
+	motion[index] = 10 * RigidBody::sleepEpsilon;
+	canSleep[index] = true;
+	isBullet[index] = false;
+	calculateDerivedData(index);
+	count++;
+
+	BodyHandle handle = { index, generation[index] };
+	return handle;
+}
+
+void BodyStore::destroy(BodyHandle handle)
+{
+	if (!isValid(handle))
+		return;
+
+	generation[handle.index]++;
+	freeSlots.push_back(handle.index);
+	count--;
+}
+
+bool BodyStore::isValid(BodyHandle handle) const
+{
+	return handle.index < generation.size() && generation[handle.index] == handle.generation;
+}
+
+void BodyStore::copy(unsigned from, unsigned to)
+{
+	positionX[to] = positionX[from];
+	positionY[to] = positionY[from];
+	orientationX[to] = orientationX[from];
+	orientationY[to] = orientationY[from];
+	velocityX[to] = velocityX[from];
+	velocityY[to] = velocityY[from];
+	angularVelocity[to] = angularVelocity[from];
+	inverseMass[to] = inverseMass[from];
+	inverseMomentOfInertia[to] = inverseMomentOfInertia[from];
+	isAwake[to] = isAwake[from];
+	accelerationX[to] = accelerationX[from];
+	accelerationY[to] = accelerationY[from];
+	forceX[to] = forceX[from];
+	forceY[to] = forceY[from];
+	torqueAccum[to] = torqueAccum[from];
+	linearDamping[to] = linearDamping[from];
+	angularDamping[to] = angularDamping[from];
+	motion[to] = motion[from];
+	canSleep[to] = canSleep[from];
+	isBullet[to] = isBullet[from];
+	transformMatrix[to] = transformMatrix[from];
+}
+
+int BodyStore::size() const
+{
+	return count;
+}
+
+int BodyStore::getCapacity() const
+{
+	return (int)generation.size();
+}
+
+bool BodyStore::getIslandSleep() const
+{
+	return islandSleep;
+}
+
+void BodyStore::setIslandSleep(bool islandSleep)
+{
+	this->islandSleep = islandSleep;
+}
+
+Vector2 BodyStore::getPosition(unsigned index) const
+{
+	return Vector2(positionX[index], positionY[index]);
+}
+
+Vector2 BodyStore::getOrientation(unsigned index) const
+{
+	return Vector2(orientationX[index], orientationY[index]);
+}
+
+Vector2 BodyStore::getVelocity(unsigned index) const
+{
+	return Vector2(velocityX[index], velocityY[index]);
+}
+
+Vector2 BodyStore::getAcceleration(unsigned index) const
+{
+	return Vector2(accelerationX[index], accelerationY[index]);
+}
+
+void BodyStore::setPosition(unsigned index, const Vector2 &position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+}
+
+void BodyStore::setOrientation(unsigned index, const Vector2 &orientation)
+{
+	orientationX[index] = orientation.x;
+	orientationY[index] = orientation.y;
+}
+
+void BodyStore::setVelocity(unsigned index, const Vector2 &velocity)
+{
+	velocityX[index] = velocity.x;
+	velocityY[index] = velocity.y;
+}
+
+void BodyStore::getPoses(std::vector<Vector2> &position, std::vector<Vector2> &orientation) const
+{
+	position.resize(positionX.size());
+	orientation.resize(orientationX.size());
+	for (unsigned i = 0; i < position.size(); i++)
+	{
+		position[i] = getPosition(i);
+		orientation[i] = getOrientation(i);
+	}
+}
+
+void BodyStore::calculateDerivedData(unsigned index)
+{
+	Vector2 orientation = getOrientation(index);
+	orientation.normalize();
+	setOrientation(index, orientation);
+	transformMatrix[index].setOrientationAndPos(orientation, getPosition(index));
+}
+
+// Integrates the bodies in slots[0, LANES) side by side, one body per
+// lane; the same code runs the SIMD batches and the scalar tail.
+template<class Lane, int LANES>
+static void integrateLanes(BodyStore &store, const unsigned *slots,
+	const real *linearFactor, const real *angularFactor, real duration)
+{
+	bool run = isSlotRun<LANES>(slots);
+
+	Lane tag = Lane();
+	Lane dt = simdSet(duration, tag);
+	Lane halfDtSquare = simdSet(duration * duration / 2, tag);
+	Lane linearDamp = simdLoad(linearFactor, tag);
+	Lane angularDamp = simdLoad(angularFactor, tag);
+	// a = f / m
+	Lane inverseMass = loadSlots<Lane, LANES>(store.inverseMass, slots, run);
+	Lane accX = simdMul(loadSlots<Lane, LANES>(store.forceX, slots, run), inverseMass);
+	Lane accY = simdMul(loadSlots<Lane, LANES>(store.forceY, slots, run), inverseMass);
+	Lane angularAcc = simdMul(loadSlots<Lane, LANES>(store.torqueAccum, slots, run),
+		loadSlots<Lane, LANES>(store.inverseMomentOfInertia, slots, run));
+
+	// v = (v + a*t) * d^t, with d^t worked out per step
+	Lane velX = simdMul(simdAdd(loadSlots<Lane, LANES>(store.velocityX, slots, run),
+		simdMul(accX, dt)), linearDamp);
+	Lane velY = simdMul(simdAdd(loadSlots<Lane, LANES>(store.velocityY, slots, run),
+		simdMul(accY, dt)), linearDamp);
+	Lane omega = simdMul(simdAdd(loadSlots<Lane, LANES>(store.angularVelocity, slots, run),
+		simdMul(angularAcc, dt)), angularDamp);
+
+	// p = p + v*t + 1/2 * a*t^2
+	Lane posX = simdAdd(simdAdd(loadSlots<Lane, LANES>(store.positionX, slots, run),
+		simdMul(velX, dt)), simdMul(accX, halfDtSquare));
+	Lane posY = simdAdd(simdAdd(loadSlots<Lane, LANES>(store.positionY, slots, run),
+		simdMul(velY, dt)), simdMul(accY, halfDtSquare));
+
+	// both rotations of the scalar path in one, then normalize
+	Lane angle = simdAdd(simdMul(omega, dt), simdMul(angularAcc, halfDtSquare));
+	Lane sine, cosine;
+	simdSinCos(angle, sine, cosine);
+	Lane oriX = loadSlots<Lane, LANES>(store.orientationX, slots, run);
+	Lane oriY = loadSlots<Lane, LANES>(store.orientationY, slots, run);
+	Lane rotX = simdSub(simdMul(oriX, cosine), simdMul(oriY, sine));
+	Lane rotY = simdAdd(simdMul(oriX, sine), simdMul(oriY, cosine));
+	Lane length = simdSqrt(simdAdd(simdMul(rotX, rotX), simdMul(rotY, rotY)));
+	Lane one = simdSet((real)1.0, tag);
+	Lane inverseLength = simdSelect(simdGreater(length, simdSet((real)0.0, tag)),
+		simdDiv(one, length), one);
+	rotX = simdMul(rotX, inverseLength);
+	rotY = simdMul(rotY, inverseLength);
+
+	Lane zero = simdSet((real)0.0, tag);
+	storeSlots<Lane, LANES>(store.positionX, slots, run, posX);
+	storeSlots<Lane, LANES>(store.positionY, slots, run, posY);
+	storeSlots<Lane, LANES>(store.orientationX, slots, run, rotX);
+	storeSlots<Lane, LANES>(store.orientationY, slots, run, rotY);
+	storeSlots<Lane, LANES>(store.velocityX, slots, run, velX);
+	storeSlots<Lane, LANES>(store.velocityY, slots, run, velY);
+	storeSlots<Lane, LANES>(store.angularVelocity, slots, run, omega);
+	storeSlots<Lane, LANES>(store.accelerationX, slots, run, accX);
+	storeSlots<Lane, LANES>(store.accelerationY, slots, run, accY);
+	storeSlots<Lane, LANES>(store.forceX, slots, run, zero);
+	storeSlots<Lane, LANES>(store.forceY, slots, run, zero);
+	storeSlots<Lane, LANES>(store.torqueAccum, slots, run, zero);
+
+	// setOrientationAndPos without normalizing again
+	for (int l = 0; l < LANES; l++)
+	{
+		unsigned i = slots[l];
+		real *matrix = store.transformMatrix[i].data;
+		matrix[0] = store.orientationX[i];
+		matrix[1] = -store.orientationY[i];
+		matrix[2] = store.positionX[i];
+		matrix[3] = store.orientationY[i];
+		matrix[4] = store.orientationX[i];
+		matrix[5] = store.positionY[i];
+	}
+}
+
+void BodyStore::integrate(const unsigned *indices, int indexCount, real duration)
+{
+	// the awake slots, with their damping over this step; bodies mostly
+	// share their damping, so pow only runs when it changes
+	awakeSlots.clear();
+	linearFactor.clear();
+	angularFactor.clear();
+	real lastLinear = -1, lastLinearFactor = 1;
+	real lastAngular = -1, lastAngularFactor = 1;
+	for (int k = 0; k < indexCount; k++)
+	{
+		unsigned i = indices[k];
+		if (!isAwake[i])
+			continue;
+
+		if (linearDamping[i] != lastLinear)
+		{
+			lastLinear = linearDamping[i];
+			lastLinearFactor = real_pow(lastLinear, duration);
+		}
+		if (angularDamping[i] != lastAngular)
+		{
+			lastAngular = angularDamping[i];
+			lastAngularFactor = real_pow(lastAngular, duration);
+		}
+		awakeSlots.push_back(i);
+		linearFactor.push_back(lastLinearFactor);
+		angularFactor.push_back(lastAngularFactor);
+	}
+
+	int awakeCount = (int)awakeSlots.size();
+	int k = 0;
+	for (; k + SIMD_LANES <= awakeCount; k += SIMD_LANES)
+		integrateLanes<SimdReal, SIMD_LANES>(*this, &awakeSlots[k],
+			&linearFactor[k], &angularFactor[k], duration);
+	for (; k < awakeCount; k++)
+		integrateLanes<real, 1>(*this, &awakeSlots[k],
+			&linearFactor[k], &angularFactor[k], duration);
+
+	const real baseBias = 0.5f;
+	real bias = real_pow(baseBias, duration);
+	for (k = 0; k < awakeCount; k++)
+	{
+		unsigned i = awakeSlots[k];
+		if (!canSleep[i])
+			continue;
+
+		real currentMotion = velocityX[i] * velocityX[i] + velocityY[i] * velocityY[i] +
+			angularVelocity[i] * angularVelocity[i];
+		motion[i] = bias * motion[i] + (1 - bias) * currentMotion;
+
+		// with island sleep the island decides once the step is resolved
+		if (motion[i] < RigidBody::sleepEpsilon && !islandSleep)
+		{
+			isAwake[i] = false;
+			velocityX[i] = 0;
+			velocityY[i] = 0;
+			angularVelocity[i] = 0;
+		}
+		else if (motion[i] > 10 * RigidBody::sleepEpsilon)
+			motion[i] = 10 * RigidBody::sleepEpsilon;
+	}
+}
@@ -0,0 +1,137 @@
+#ifndef __BODYSTORE_H_INCLUDED__
+#define __BODYSTORE_H_INCLUDED__
+
+
+#include <vector>
+
+#include "precision.h"
+#include "core.h"
+#include "simd.h"
+
+// names a slot of the BodyStore; the generation tells a live body from
+// a destroyed one whose slot was handed out again
+struct BodyHandle
+{
+	unsigned index;
+	unsigned generation;
+};
+
+// Rigid body state in structure-of-arrays columns, one slot per body.
+// RigidBody is a thin view holding its store and a handle, so
+// integration and the solver stream each column instead of whole
+// objects. Vectors are split into an x and a y column, so the lanes of a
+// run of consecutive slots load straight from the columns. Each World
+// owns one store, and its bodies are created in it, so the columns hold
+// one simulation. Destroyed slots go on a free list and are reused,
+// bumping their generation.
+//
+// Slots are created and destroyed from one thread; the columns may be
+// read and written from several as long as the slots differ.
+class BodyStore
+{
+public:
+	typedef std::vector<real, SimdAllocator<real> > Column;
+
+	// hot columns, indexed by BodyHandle::index
+	Column positionX, positionY; // position of center of mass
+	Column orientationX, orientationY;
+	Column velocityX, velocityY;
+	Column angularVelocity;
+	Column inverseMass;
+	Column inverseMomentOfInertia;
+	std::vector<unsigned char> isAwake;
+
+	// integration only
+	Column accelerationX, accelerationY;
+	Column forceX, forceY; // accumulated
+	Column torqueAccum;
+	std::vector<real> linearDamping; // 0 to 1
+	std::vector<real> angularDamping; // 0 to 1
+	std::vector<real> motion;
+	std::vector<unsigned char> canSleep;
+	std::vector<unsigned char> isBullet; // swept by CollisionSpace::sweepBullets
+	std::vector<Matrix3> transformMatrix; // only rotation and translation
+
+protected:
+	std::vector<unsigned> generation;
+	std::vector<unsigned> freeSlots;
+	int count; // live slots
+	bool islandSleep; // bodies do not sleep alone, see IslandGraph
+
+	// integrate scratch
+	std::vector<unsigned> awakeSlots;
+	std::vector<real> linearFactor; // damping over the step, per awake slot
+	std::vector<real> angularFactor;
+
+public:
+	BodyStore();
+
+	BodyHandle create(); // a resting unit body at the origin
+	void destroy(BodyHandle handle);
+	bool isValid(BodyHandle handle) const;
+	void copy(unsigned from, unsigned to); // every column of a slot
+
+	// accessor
+	int size() const; // live slots
+	int getCapacity() const; // live and free slots
+	bool getIslandSleep() const;
+	void setIslandSleep(bool islandSleep);
+
+	// a slot's vectors out of their x and y columns
+	Vector2 getPosition(unsigned index) const;
+	Vector2 getOrientation(unsigned index) const;
+	Vector2 getVelocity(unsigned index) const;
+	Vector2 getAcceleration(unsigned index) const;
+	void setPosition(unsigned index, const Vector2 &position);
+	void setOrientation(unsigned index, const Vector2 &orientation);
+	void setVelocity(unsigned index, const Vector2 &velocity);
+	// every slot's position and orientation, for the pose copies
+	void getPoses(std::vector<Vector2> &position, std::vector<Vector2> &orientation) const;
+
+	void calculateDerivedData(unsigned index);
+	// integrates the awake bodies of the given slots SIMD_LANES at a time
+	// (simd.h); matches RigidBody's scalar formulas to rounding
+	void integrate(const unsigned *indices, int indexCount, real duration);
+};
+
+// Lane helpers for kernels over BodyStore columns (simd.h): a run of
+// consecutive slots loads and stores straight from the columns, any
+// other slots go through a gather.
+template<int LANES>
+bool isSlotRun(const unsigned *slots)
+{
+	for (int l = 1; l < LANES; l++)
+		if (slots[l] != slots[0] + l)
+			return false;
+	return true;
+}
+
+template<class Lane, int LANES>
+Lane loadSlots(const BodyStore::Column &column, const unsigned *slots, bool run)
+{
+	if (run)
+		return simdLoad(&column[slots[0]], Lane());
+
+	real lanes[LANES];
+	for (int l = 0; l < LANES; l++)
+		lanes[l] = column[slots[l]];
+	return simdLoad(lanes, Lane());
+}
+
+template<class Lane, int LANES>
+void storeSlots(BodyStore::Column &column, const unsigned *slots, bool run, Lane value)
+{
+	if (run)
+	{
+		simdStore(&column[slots[0]], value);
+		return;
+	}
+
+	real lanes[LANES];
+	simdStore(lanes, value);
+	for (int l = 0; l < LANES; l++)
+		column[slots[l]] = lanes[l];
+}
+
+
+#endif // __BODYSTORE_H_INCLUDED__
@@ -3,7 +3,7 @@
 CarApp::CarApp() :
 RigidBodyApplication()
 {
-	bool isWheelOn = false;
+	isWheelOn = false;
 
 	// wall
 	real wallDist = 0.9;
@@ -12,40 +12,47 @@ RigidBodyApplication()
 	planes[2] = CollisionPlane(Vector2::X, -wallDist * 2);
 	planes[3] = CollisionPlane(-Vector2::X, -wallDist * 2);
 
-	// car
+	// car, the chassis and its cabin are one body at their center of mass
 	Vector2 carPosition(-1.2, -0.5);
 	real wheelMass = 1;
 	real wheelRadius = 0.10;
 	real wheelMOI = wheelMass * sphereMOIPerMass(wheelRadius);
-	real carMass = 10;
-	Vector2 carHalfSize(0.4, 0.1);
-	Vector2 carTopHalfSize(0.2, 0.1);
-	real carMOI = carMass * boixMOIPerMass(carHalfSize);
-	Vector2 carWheelOffset1(+0.25, -0.1);
-	Vector2 carWheelOffset2(-0.25, -0.1);
-	Vector2 carTopOffset(-0.1, 0.2);
-
-	sphere_bodies[0] = RigidBody(carPosition + carWheelOffset1,
+	real chassisMass = 10;
+	real cabinMass = 10;
+	Vector2 chassisHalfSize(0.4, 0.1);
+	Vector2 cabinHalfSize(0.2, 0.1);
+	Vector2 cabinOffset(-0.1, 0.2); // from the chassis center
+	Vector2 centerOfMass = cabinOffset * (cabinMass / (chassisMass + cabinMass));
+	Vector2 chassisOffset = centerOfMass * -1;
+	cabinOffset = cabinOffset - centerOfMass;
+	real carMass = chassisMass + cabinMass;
+	real carMOI = chassisMass * (boixMOIPerMass(chassisHalfSize) + chassisOffset.squareMagnitude()) +
+		cabinMass * (boixMOIPerMass(cabinHalfSize) + cabinOffset.squareMagnitude());
+	Vector2 carWheelOffset1 = Vector2(+0.25, -0.1) + chassisOffset;
+	Vector2 carWheelOffset2 = Vector2(-0.25, -0.1) + chassisOffset;
+
+	box_bodies[0] = RigidBody(world.getBodyStore(), carPosition + centerOfMass,
+		Vector2::X, 1.0f / carMass, 1.0f / carMOI);
+	sphere_bodies[0] = RigidBody(world.getBodyStore(),
+		box_bodies[0].getPosition() + carWheelOffset1,
 		Vector2::X, 1.0f / wheelMass, 1.0f / wheelMOI);
 	spheres[0] = CollisionSphere(&sphere_bodies[0], wheelRadius);
-	sphere_bodies[1] = RigidBody(carPosition + carWheelOffset2,
+	sphere_bodies[1] = RigidBody(world.getBodyStore(),
+		box_bodies[0].getPosition() + carWheelOffset2,
 		Vector2::X, 1.0f / wheelMass, 1.0f / wheelMOI);
 	spheres[1] = CollisionSphere(&sphere_bodies[1], wheelRadius);
 
-	box_bodies[0] = RigidBody(carPosition, 
-		Vector2::X, 1.0f / carMass, 1.0f / carMOI);
-	boxes[0] = CollisionBox(&box_bodies[0], carHalfSize);
-	box_bodies[1] = RigidBody(carPosition + carTopOffset,
-		Vector2::X, 1.0f / carMass, 1.0f / carMOI);
-	boxes[1] = CollisionBox(&box_bodies[1], carTopHalfSize);
+	chassis = CollisionCompound(&box_bodies[0]);
+	boxes[0].halfSize = chassisHalfSize;
+	chassis.add(&boxes[0], chassisOffset);
+	boxes[1].halfSize = cabinHalfSize;
+	chassis.add(&boxes[1], cabinOffset);
 
 	real jointError = 0.05;
 	joints[0] = Joint(&sphere_bodies[0], Vector2(0.0, 0.0),
 		&box_bodies[0], carWheelOffset1, jointError);
 	joints[1] = Joint(&sphere_bodies[1], Vector2(0.0, 0.0),
 		&box_bodies[0], carWheelOffset2, jointError);
-	joints[2] = Joint(&box_bodies[1], Vector2(0.0, 0.0),
-		&box_bodies[0], carTopOffset, 0.0);
 
 	real k = 1000;
 	real c = 2 * real_sqrt((wheelMass + carMass) * k) * 0.8;
@@ -67,12 +74,14 @@ RigidBodyApplication()
 
 	for (int i = 2; i < SPHERE_NUM; i++)
 	{
-		sphere_bodies[i] = RigidBody(sphereStackPosition + Vector2(0, (real)(i - 2) * sphereRadius * 2),
+		sphere_bodies[i] = RigidBody(world.getBodyStore(),
+			sphereStackPosition + Vector2(0, (real)(i - 2) * sphereRadius * 2),
 			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
 	}
 	for (int i = 2; i < BOX_NUM; i++)
 	{
-		box_bodies[i] = RigidBody(boxStackPosition + Vector2(0, (real)(i - 2) * boxHalfSize.y * 2),
+		box_bodies[i] = RigidBody(world.getBodyStore(),
+			boxStackPosition + Vector2(0, (real)(i - 2) * boxHalfSize.y * 2),
 			Vector2(1, 0.0), 1.0f / boxMass, 1.0f / boxMOI);
 	}
 
@@ -81,11 +90,26 @@ RigidBodyApplication()
 
 	for (int i = 2; i < BOX_NUM; i++)
 		boxes[i] = CollisionBox(&box_bodies[i], boxHalfSize);
+
+	// wheels sit inside the chassis, keep them off the boxes
+	const unsigned wheelCategory = 2;
+	const unsigned boxCategory = 4;
+	for (int i = 0; i < SPHERE_NUM; i++)
+	{
+		if (i < 2)
+			collisionSpace.add(&spheres[i], wheelCategory, ~boxCategory);
+		else
+			collisionSpace.add(&spheres[i]);
+	}
+	collisionSpace.add(&chassis, boxCategory);
+	for (int i = 2; i < BOX_NUM; i++)
+		collisionSpace.add(&boxes[i], boxCategory);
 	
 	// assign to world
 	for (int i = 0; i < SPHERE_NUM; i++)
 		world.getRigidBodies().push_back(&sphere_bodies[i]);
-	for (int i = 0; i < BOX_NUM; i++)
+	world.getRigidBodies().push_back(&box_bodies[0]); // box 1 is on it too
+	for (int i = 2; i < BOX_NUM; i++)
 		world.getRigidBodies().push_back(&box_bodies[i]);
 
 	World::RigidBodies::iterator i = world.getRigidBodies().begin();
@@ -108,19 +132,9 @@ RigidBodyApplication()
 void CarApp::generateContacts()
 {
 	collisionData.reset();
+	collisionSpace.generateContacts(&collisionData);
 
-	for (int i = 0; i < SPHERE_NUM; i++)
-		for (int j = i + 1; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndSphere(spheres[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = i + 1; j < BOX_NUM; j++)
-			CollisionDetector::boxAndBox2(boxes[i], boxes[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = 2; j < SPHERE_NUM; j++)
-			CollisionDetector::boxAndSphere(boxes[i], spheres[j], &collisionData);
-
+	// planes stay separate, wheels get more friction than the boxes
 	for (int i = 0; i < PLANE_NUM; i++)
 	{
 		collisionData.friction = 10;
@@ -128,7 +142,13 @@ void CarApp::generateContacts()
 			CollisionDetector::sphereAndHalfSpace(spheres[j], planes[i], &collisionData);
 		collisionData.friction = 0.5;
 		for (int j = 0; j < BOX_NUM; j++)
+		{
+			// boxes 0 and 1 share a body, the box tells their corners apart
+			Contact *first = collisionData.contacts;
 			CollisionDetector::boxAndHalfSpace(boxes[j], planes[i], &collisionData);
+			for (Contact *c = first; c < collisionData.contacts; c++)
+				c->feature |= (unsigned)j << 8;
+		}
 	}
 }
 
@@ -1,8 +1,6 @@
 #ifndef __CAR_H_INCLUDED__
 #define __CAR_H_INCLUDED__
 
-#include <windows.h>
-#include <GL/glut.h>
 #include <iostream>
 
 #include "precision.h"
@@ -24,13 +22,14 @@ protected:
 	static const int SPHERE_NUM = 20;
 	static const int BOX_NUM = 20;
 	static const int PLANE_NUM = 4;
-	static const int JOINT_NUM = 3;
+	static const int JOINT_NUM = 2;
 
 	RigidBody sphere_bodies[SPHERE_NUM];
 	RigidBody box_bodies[BOX_NUM];
 
 	CollisionSphere spheres[SPHERE_NUM];
 	CollisionBox boxes[BOX_NUM];
+	CollisionCompound chassis; // boxes 0 and 1 on box_bodies[0]
 	CollisionPlane planes[PLANE_NUM];
 
 	Joint joints[JOINT_NUM];
@@ -1,80 +1,52 @@
+#include <algorithm>
+
 #include "collide_coarse.h"
 
 template<class BoundingVolumeClass>
 BVHNode<BoundingVolumeClass>::BVHNode
-	(BVHNode* parent, const BoundingVolumeClass &volume, RigidBody* body = NULL)
+	(BVHNode* parent, const BoundingVolumeClass &volume, RigidBody* body, int index)
 {
 	this->parent = parent;
 	this->volume = volume;
 	this->body = body;
+	this->index = index;
 	children[0] = NULL;
 	children[1] = NULL;
 }
 
-template<class BoundingVolumeClass>
-BVHNode<BoundingVolumeClass>::~BVHNode()
-{
-	if (parent != NULL)
-	{
-		BVHNode<BoundingVolumeClass> *sibling;
-		if (this == parent->children[0])
-			sibling = parent->children[1];
-		else
-			sibling = parent->children[0];
-
-		parent->volume = sibling->volume;
-		parent->body = sibling->body;
-		parent->children[0] = sibling->children[0];
-		parent->children[1] = sibling->children[1];
-
-		sibling->parent = NULL;
-		sibling->volume = NULL;
-		sibling->children[0] = NULL;
-		sibling->children[1] = NULL;
-		delete sibling;
-
-		parent->recalculateBoundingVolume();
-	}
-
-	if (children[0] != NULL)
-	{
-		children[0]->parent = NULL;
-		delete children[0];
-	}
-	if (children[1] != NULL)
-	{
-		children[1]->parent = NULL;
-		delete children[1];
-	}
-}
-
 template<class BoundingVolumeClass>
 bool BVHNode<BoundingVolumeClass>::isLeaf() const
 {
-	return (body != NULL);
+	return (children[0] == NULL);
 }
 
 template<class BoundingVolumeClass>
-bool BVHNode<BoundingVolumeClass>::overlaps(BVHNode<BoundingVolumeClass>* other) const
+bool BVHNode<BoundingVolumeClass>::overlaps(const BVHNode<BoundingVolumeClass>* other) const
 {
-	return volume.overlaps(other->volume); // ?
+	return volume.overlaps(&other->volume);
 }
 
 template<class BoundingVolumeClass>
 int BVHNode<BoundingVolumeClass>::getPotentialContacts
 	(PotentialContact* contacts, int limit) const
 {
-	if (isLeaf() || limit == 0)
+	if (isLeaf() || limit <= 0)
 		return 0;
-	int count = children[0]->getPotentialContactsWith(children[1], contacts, limit);
+
+	// pairs inside each child, then pairs across the two
+	int count = children[0]->getPotentialContacts(contacts, limit);
+	if (limit > count)
+		count += children[1]->getPotentialContacts(contacts + count, limit - count);
+	if (limit > count)
+		count += children[0]->getPotentialContactsWith(children[1], contacts + count, limit - count);
 	return count;
 }
 
 template<class BoundingVolumeClass>
 int BVHNode<BoundingVolumeClass>::getPotentialContactsWith
-	(BVHNode<BoundingVolumeClass>* other, PotentialContact* contacts, int limit) const
+	(const BVHNode<BoundingVolumeClass>* other, PotentialContact* contacts, int limit) const
 {
-	if (!overlaps(other) || limit == 0)
+	if (!overlaps(other) || limit <= 0)
 		return 0;
 
 	// potential contact found
@@ -87,7 +59,7 @@ int BVHNode<BoundingVolumeClass>::getPotentialContactsWith
 
 	int count;
 	// traverse the bigger node
-	if (other->isLeaf() || !isLeaft() && volume->getSize() > other->volume->getSize())
+	if (other->isLeaf() || (!isLeaf() && volume.getSize() > other->volume.getSize()))
 	{ // traverse this node
 		count = children[0]->getPotentialContactsWith(other, contacts, limit);
 		if (limit > count)
@@ -103,39 +75,26 @@ int BVHNode<BoundingVolumeClass>::getPotentialContactsWith
 }
 
 template<class BoundingVolumeClass>
-void BVHNode<BoundingVolumeClass>::insert
-	(RigidBody* newBody, const BoundingVolumeClass &newVolume)
+void BVHNode<BoundingVolumeClass>::recalculateBoundingVolume(bool recurse)
 {
-	if (isLeaf())
+	BVHNode<BoundingVolumeClass>* node = this;
+	while (node != NULL)
 	{
-		BVHNode(this, volume, body);
-		BVHNode(this, newVolume, newBody);
-		this->body = NULL;
-		recalculateBoundingVolume();
-	}
-	else
-	{
-		if (children[0]->getGrowth(newVolume) < children[1]->getGrowth(newVolume))
-			children[0]->insert(newBody, newVolume);
-		else
-			children[1]->insert(newBody, newVolume);
+		if (!node->isLeaf())
+			node->volume = BoundingVolumeClass(node->children[0]->volume,
+				node->children[1]->volume);
+		if (!recurse)
+			break;
+		node = node->parent;
 	}
 }
 
-template<class BoundingVolumeClass>
-void BVHNode<BoundingVolumeClass>::recalculateBoundingVolume(bool recurse)
-{
-	if (isLeaf())
-		return;
 
-	volume = BoundingVolumeClass(children[0]->volume, children[1]->volume);
-
-	// recuse up to root
-	if (parent != NULL)
-		parent->recalculateBoundingVolume(true);
+BoundingSphere::BoundingSphere()
+{
+	radius = 0;
 }
 
-
 BoundingSphere::BoundingSphere(const Vector2 &center, real radius)
 {
 	this->center = center;
@@ -148,7 +107,7 @@ BoundingSphere::BoundingSphere(const BoundingSphere &one, const BoundingSphere &
 	real d = centerOffset.magnitude();
 	real radiusDiff = real_abs(one.radius - other.radius);
 
-	if (radiusDiff <= d) // enclosure
+	if (radiusDiff >= d) // enclosure
 	{
 		if (one.radius > other.radius)
 		{
@@ -173,8 +132,633 @@ bool BoundingSphere::overlaps(const BoundingSphere *other) const
 	return ((center - other->center).magnitude() <= radius + other->radius);
 }
 
+real BoundingSphere::getSize() const
+{
+	return radius;
+}
+
 real BoundingSphere::getGrowth(const BoundingSphere &other) const
 {
 	BoundingSphere s(*this, other);
 	return (s.radius - radius);
-}
\ No newline at end of file
+}
+
+
+BoundingBox::BoundingBox()
+{}
+
+BoundingBox::BoundingBox(const Vector2 &min, const Vector2 &max)
+{
+	this->min = min;
+	this->max = max;
+}
+
+BoundingBox::BoundingBox(const BoundingBox &one, const BoundingBox &other)
+{
+	min.x = real_fmin(one.min.x, other.min.x);
+	min.y = real_fmin(one.min.y, other.min.y);
+	max.x = real_fmax(one.max.x, other.max.x);
+	max.y = real_fmax(one.max.y, other.max.y);
+}
+
+bool BoundingBox::overlaps(const BoundingBox *other) const
+{
+	return (min.x <= other->max.x && other->min.x <= max.x
+		&& min.y <= other->max.y && other->min.y <= max.y);
+}
+
+bool BoundingBox::contains(const BoundingBox &other) const
+{
+	return (min.x <= other.min.x && min.y <= other.min.y
+		&& other.max.x <= max.x && other.max.y <= max.y);
+}
+
+real BoundingBox::getSize() const
+{
+	return 2 * ((max.x - min.x) + (max.y - min.y));
+}
+
+real BoundingBox::getGrowth(const BoundingBox &other) const
+{
+	BoundingBox b(*this, other);
+	return (b.getSize() - getSize());
+}
+
+
+SpatialHash::SpatialHash(real cellSize, int tableSize)
+{
+	this->cellSize = cellSize;
+
+	// round up to a power of two so the hash can be masked
+	this->tableSize = 1;
+	while (this->tableSize < tableSize)
+		this->tableSize <<= 1;
+	bucketCount = this->tableSize;
+}
+
+void SpatialHash::setCellSize(real cellSize)
+{
+	this->cellSize = cellSize;
+}
+
+real SpatialHash::getCellSize() const
+{
+	return cellSize;
+}
+
+int SpatialHash::hash(int cellX, int cellY) const
+{
+	unsigned h = (unsigned)cellX * 73856093u ^ (unsigned)cellY * 19349663u;
+	return (int)(h & (unsigned)(bucketCount - 1));
+}
+
+int SpatialHash::cellOf(real coordinate, real inverseCellSize) const
+{
+	return (int)floor(coordinate * inverseCellSize);
+}
+
+int SpatialHash::getPotentialContacts(const BoundingBox *boxes, int count,
+	PotentialPair *pairs, int limit)
+{
+	if (count < 2 || limit <= 0)
+		return 0;
+
+	real size = cellSize;
+	if (size <= 0)
+	{
+		real extent = 0;
+		for (int i = 0; i < count; i++)
+			extent += real_fmax(boxes[i].max.x - boxes[i].min.x,
+				boxes[i].max.y - boxes[i].min.y);
+		size = 2 * extent / count;
+		if (size <= 0)
+			size = 1;
+	}
+	real inverseSize = 1 / size;
+
+	// bin every box into each cell it touches
+	entries.clear();
+	for (int i = 0; i < count; i++)
+	{
+		int x0 = cellOf(boxes[i].min.x, inverseSize);
+		int x1 = cellOf(boxes[i].max.x, inverseSize);
+		int y0 = cellOf(boxes[i].min.y, inverseSize);
+		int y1 = cellOf(boxes[i].max.y, inverseSize);
+		for (int x = x0; x <= x1; x++)
+			for (int y = y0; y <= y1; y++)
+			{
+				Entry entry = { x, y, i };
+				entries.push_back(entry);
+			}
+	}
+
+	// about two buckets per entry keeps small scenes from paying for the
+	// whole table
+	bucketCount = 1;
+	while (bucketCount < tableSize && bucketCount < 2 * (int)entries.size())
+		bucketCount <<= 1;
+
+	// counting sort by bucket
+	bucketStart.assign(bucketCount + 1, 0);
+	for (size_t e = 0; e < entries.size(); e++)
+		bucketStart[hash(entries[e].cellX, entries[e].cellY) + 1]++;
+	for (int b = 0; b < bucketCount; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	sorted.resize(entries.size());
+	for (size_t e = 0; e < entries.size(); e++)
+	{
+		int b = hash(entries[e].cellX, entries[e].cellY);
+		sorted[bucketStart[b]++] = entries[e];
+	}
+	// the scatter advanced each start to the next bucket's start
+	for (int b = bucketCount; b > 0; b--)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+
+	int used = 0;
+	for (int b = 0; b < bucketCount; b++)
+	{
+		int end = bucketStart[b + 1];
+		for (int i = bucketStart[b]; i < end; i++)
+		{
+			const Entry &one = sorted[i];
+			for (int j = i + 1; j < end; j++)
+			{
+				const Entry &other = sorted[j];
+				// different cells that share a bucket
+				if (one.cellX != other.cellX || one.cellY != other.cellY)
+					continue;
+
+				const BoundingBox &a = boxes[one.index];
+				const BoundingBox &c = boxes[other.index];
+				if (!a.overlaps(&c))
+					continue;
+
+				// boxes spanning several cells meet in several of them, only
+				// report the pair from the cell holding the overlap's min corner
+				if (cellOf(real_fmax(a.min.x, c.min.x), inverseSize) != one.cellX
+					|| cellOf(real_fmax(a.min.y, c.min.y), inverseSize) != one.cellY)
+					continue;
+
+				if (one.index < other.index)
+				{
+					pairs[used].index[0] = one.index;
+					pairs[used].index[1] = other.index;
+				}
+				else
+				{
+					pairs[used].index[0] = other.index;
+					pairs[used].index[1] = one.index;
+				}
+				if (++used == limit)
+					return used;
+			}
+		}
+	}
+
+	return used;
+}
+
+
+BVHTree::BVHTree(real margin)
+{
+	root = NULL;
+	this->margin = margin;
+}
+
+BVHTree::~BVHTree()
+{
+	clear();
+}
+
+BoundingBox BVHTree::fatten(const BoundingBox &box) const
+{
+	Vector2 m(margin, margin);
+	return BoundingBox(box.min - m, box.max + m);
+}
+
+void BVHTree::insertLeaf(Node* leaf)
+{
+	if (root == NULL)
+	{
+		root = leaf;
+		leaf->parent = NULL;
+		return;
+	}
+
+	// descend while pushing the leaf further down is cheaper than pairing
+	// it with the current node
+	const BoundingBox &box = leaf->volume;
+	Node* node = root;
+	while (!node->isLeaf())
+	{
+		real size = node->volume.getSize();
+		real combined = BoundingBox(node->volume, box).getSize();
+
+		real cost = 2 * combined;
+		real inheritance = 2 * (combined - size);
+
+		real childCost[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const BoundingBox &childVolume = node->children[i]->volume;
+			childCost[i] = BoundingBox(childVolume, box).getSize() + inheritance;
+			if (!node->children[i]->isLeaf())
+				childCost[i] -= childVolume.getSize();
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+		node = node->children[childCost[0] < childCost[1] ? 0 : 1];
+	}
+
+	// new parent joining node and leaf, in node's place
+	Node* oldParent = node->parent;
+	Node* newParent = new Node(oldParent, BoundingBox(node->volume, box));
+	newParent->children[0] = node;
+	newParent->children[1] = leaf;
+	node->parent = newParent;
+	leaf->parent = newParent;
+
+	if (oldParent == NULL)
+		root = newParent;
+	else if (oldParent->children[0] == node)
+		oldParent->children[0] = newParent;
+	else
+		oldParent->children[1] = newParent;
+
+	newParent->recalculateBoundingVolume();
+}
+
+void BVHTree::removeLeaf(Node* leaf)
+{
+	if (leaf == root)
+	{
+		root = NULL;
+		return;
+	}
+
+	// the sibling takes the parent's place, the parent is deleted
+	Node* parent = leaf->parent;
+	Node* grandParent = parent->parent;
+	Node* sibling = (parent->children[0] == leaf) ? parent->children[1] : parent->children[0];
+
+	sibling->parent = grandParent;
+	if (grandParent == NULL)
+		root = sibling;
+	else
+	{
+		if (grandParent->children[0] == parent)
+			grandParent->children[0] = sibling;
+		else
+			grandParent->children[1] = sibling;
+		grandParent->recalculateBoundingVolume();
+	}
+
+	delete parent;
+	leaf->parent = NULL;
+}
+
+void BVHTree::insert(int index, const BoundingBox &box, RigidBody* body)
+{
+	if (index >= (int)leaves.size())
+		leaves.resize(index + 1, NULL);
+	if (leaves[index] != NULL)
+		remove(index);
+
+	Node* leaf = new Node(NULL, fatten(box), body, index);
+	leaves[index] = leaf;
+	insertLeaf(leaf);
+}
+
+void BVHTree::remove(int index)
+{
+	if (index >= (int)leaves.size() || leaves[index] == NULL)
+		return;
+
+	removeLeaf(leaves[index]);
+	delete leaves[index];
+	leaves[index] = NULL;
+}
+
+bool BVHTree::update(int index, const BoundingBox &box)
+{
+	if (index >= (int)leaves.size() || leaves[index] == NULL)
+	{
+		insert(index, box);
+		return true;
+	}
+
+	Node* leaf = leaves[index];
+	if (leaf->volume.contains(box))
+		return false;
+
+	removeLeaf(leaf);
+	leaf->volume = fatten(box);
+	insertLeaf(leaf);
+	return true;
+}
+
+void BVHTree::clear()
+{
+	// iterative, so deep trees cannot overflow the call stack
+	stack.clear();
+	if (root != NULL)
+		stack.push_back(root);
+	while (!stack.empty())
+	{
+		Node* node = stack.back();
+		stack.pop_back();
+		if (!node->isLeaf())
+		{
+			stack.push_back(node->children[0]);
+			stack.push_back(node->children[1]);
+		}
+		delete node;
+	}
+
+	root = NULL;
+	leaves.clear();
+}
+
+const BVHTree::Node* BVHTree::getRoot() const
+{
+	return root;
+}
+
+int BVHTree::getHeight() const
+{
+	int height = 0;
+	for (size_t i = 0; i < leaves.size(); i++)
+	{
+		int depth = 0;
+		for (const Node* node = leaves[i]; node != NULL; node = node->parent)
+			depth++;
+		if (depth > height)
+			height = depth;
+	}
+	return height;
+}
+
+void BVHTree::query(const BoundingBox &box, std::vector<int> &result)
+{
+	stack.clear();
+	if (root != NULL)
+		stack.push_back(root);
+	while (!stack.empty())
+	{
+		Node* node = stack.back();
+		stack.pop_back();
+		if (!node->volume.overlaps(&box))
+			continue;
+
+		if (node->isLeaf())
+			result.push_back(node->index);
+		else
+		{
+			stack.push_back(node->children[0]);
+			stack.push_back(node->children[1]);
+		}
+	}
+}
+
+int BVHTree::getPotentialContacts(const BoundingBox *boxes, int count,
+	PotentialPair *pairs, int limit)
+{
+	for (int i = 0; i < count; i++)
+		update(i, boxes[i]);
+	for (int i = count; i < (int)leaves.size(); i++)
+		remove(i);
+	leaves.resize(count);
+
+	int used = 0;
+	for (int i = 0; i < count && used < limit; i++)
+	{
+		// walk the tree with the tight box, fat leaves only prune
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty() && used < limit)
+		{
+			Node* node = stack.back();
+			stack.pop_back();
+			if (!node->volume.overlaps(&boxes[i]))
+				continue;
+
+			if (!node->isLeaf())
+			{
+				stack.push_back(node->children[0]);
+				stack.push_back(node->children[1]);
+			}
+			else if (node->index > i && boxes[i].overlaps(&boxes[node->index]))
+			{
+				pairs[used].index[0] = i;
+				pairs[used].index[1] = node->index;
+				used++;
+			}
+		}
+	}
+
+	return used;
+}
+
+
+static real axisValue(const Vector2 &vector, int axis)
+{
+	return (axis == 0) ? vector.x : vector.y;
+}
+
+SweepAndPrune::SweepAndPrune(int axis)
+{
+	this->axis = axis;
+	objectCount = 0;
+}
+
+void SweepAndPrune::clear()
+{
+	endpoints.clear();
+	intervalPairs.clear();
+	pairTable.clear();
+	added.clear();
+	removed.clear();
+	objectCount = 0;
+}
+
+bool SweepAndPrune::less(const Endpoint &one, const Endpoint &other)
+{
+	// on a tie the min comes first, so touching intervals overlap
+	if (one.value != other.value)
+		return one.value < other.value;
+	return one.isMin && !other.isMin;
+}
+
+void SweepAndPrune::addPair(int one, int other)
+{
+	if (one > other)
+		std::swap(one, other);
+	HashTable::Key key = HashTable::makeKey(one, other);
+	if (pairTable.find(key) >= 0)
+		return;
+
+	Pair pair;
+	pair.index[0] = one;
+	pair.index[1] = other;
+	pair.overlapping = false;
+	pairTable.insert(key, (int)intervalPairs.size());
+	intervalPairs.push_back(pair);
+}
+
+void SweepAndPrune::removePair(int one, int other)
+{
+	if (one > other)
+		std::swap(one, other);
+	HashTable::Key key = HashTable::makeKey(one, other);
+	int position = pairTable.find(key);
+	if (position < 0)
+		return;
+
+	if (intervalPairs[position].overlapping)
+	{
+		PotentialPair event = { { one, other } };
+		removed.push_back(event);
+	}
+
+	// the last pair fills the gap
+	pairTable.remove(key);
+	const Pair &last = intervalPairs.back();
+	if (position != (int)intervalPairs.size() - 1)
+	{
+		intervalPairs[position] = last;
+		pairTable.insert(HashTable::makeKey(last.index[0], last.index[1]), position);
+	}
+	intervalPairs.pop_back();
+}
+
+void SweepAndPrune::rebuild(const BoundingBox *boxes, int count)
+{
+	for (size_t i = 0; i < intervalPairs.size(); i++)
+	{
+		if (intervalPairs[i].overlapping)
+		{
+			PotentialPair event = { { intervalPairs[i].index[0], intervalPairs[i].index[1] } };
+			removed.push_back(event);
+		}
+	}
+	intervalPairs.clear();
+	pairTable.clear();
+
+	endpoints.resize(2 * count);
+	for (int i = 0; i < count; i++)
+	{
+		Endpoint& min = endpoints[2 * i];
+		Endpoint& max = endpoints[2 * i + 1];
+		min.value = axisValue(boxes[i].min, axis);
+		min.index = i;
+		min.isMin = true;
+		max.value = axisValue(boxes[i].max, axis);
+		max.index = i;
+		max.isMin = false;
+	}
+	std::sort(endpoints.begin(), endpoints.end(), less);
+
+	// one sweep, every open interval overlaps the one that starts
+	std::vector<int> open;
+	for (size_t i = 0; i < endpoints.size(); i++)
+	{
+		const Endpoint& endpoint = endpoints[i];
+		if (endpoint.isMin)
+		{
+			for (size_t j = 0; j < open.size(); j++)
+				addPair(endpoint.index, open[j]);
+			open.push_back(endpoint.index);
+		}
+		else
+		{
+			open.erase(std::find(open.begin(), open.end(), endpoint.index));
+		}
+	}
+
+	objectCount = count;
+}
+
+const std::vector<PotentialPair>& SweepAndPrune::getAddedPairs() const
+{
+	return added;
+}
+
+const std::vector<PotentialPair>& SweepAndPrune::getRemovedPairs() const
+{
+	return removed;
+}
+
+int SweepAndPrune::getIntervalPairCount() const
+{
+	return (int)intervalPairs.size();
+}
+
+int SweepAndPrune::getPotentialContacts(const BoundingBox *boxes, int count,
+	PotentialPair *pairs, int limit)
+{
+	added.clear();
+	removed.clear();
+
+	if (count != objectCount)
+		rebuild(boxes, count);
+	else
+	{
+		for (size_t i = 0; i < endpoints.size(); i++)
+		{
+			Endpoint& endpoint = endpoints[i];
+			const BoundingBox& box = boxes[endpoint.index];
+			endpoint.value = axisValue(endpoint.isMin ? box.min : box.max, axis);
+		}
+
+		// insertion sort; every swap of a min and a max starts or ends
+		// the overlap of two intervals
+		for (size_t i = 1; i < endpoints.size(); i++)
+		{
+			Endpoint endpoint = endpoints[i];
+			int j = (int)i - 1;
+			while (j >= 0 && less(endpoint, endpoints[j]))
+			{
+				const Endpoint& other = endpoints[j];
+				if (endpoint.isMin && !other.isMin)
+					addPair(endpoint.index, other.index);
+				else if (!endpoint.isMin && other.isMin)
+					removePair(endpoint.index, other.index);
+				endpoints[j + 1] = other;
+				j--;
+			}
+			endpoints[j + 1] = endpoint;
+		}
+	}
+
+	int used = 0;
+	for (size_t i = 0; i < intervalPairs.size(); i++)
+	{
+		Pair& pair = intervalPairs[i];
+		bool overlapping = boxes[pair.index[0]].overlaps(&boxes[pair.index[1]]);
+		if (overlapping != pair.overlapping)
+		{
+			PotentialPair event = { { pair.index[0], pair.index[1] } };
+			if (overlapping)
+				added.push_back(event);
+			else
+				removed.push_back(event);
+			pair.overlapping = overlapping;
+		}
+
+		if (overlapping && used < limit)
+		{
+			pairs[used].index[0] = pair.index[0];
+			pairs[used].index[1] = pair.index[1];
+			used++;
+		}
+	}
+
+	return used;
+}
+
+
+template class BVHNode<BoundingSphere>;
+template class BVHNode<BoundingBox>;
\ No newline at end of file
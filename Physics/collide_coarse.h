@@ -7,12 +7,24 @@
 #include "precision.h"
 #include "core.h"
 #include "body.h"
+#include "table.h"
 
 struct PotentialContact
 {
 	RigidBody* body[2];
 };
 
+// pair of indices into the bounding boxes handed to a Broadphase,
+// index[0] < index[1]
+struct PotentialPair
+{
+	int index[2];
+};
+
+// Node of a bounding volume hierarchy. Leaves carry a body and/or an
+// index chosen by the owner, internal nodes always have two children.
+// Structure changes (insert, remove) are done by BVHTree, deleting a node
+// never touches its children.
 template<class BoundingVolumeClass>
 class BVHNode
 {
@@ -21,18 +33,18 @@ public:
 	BVHNode* parent;
 	BoundingVolumeClass volume;
 	RigidBody* body;
+	int index;
 
 public:
 	BVHNode(BVHNode* parent, const BoundingVolumeClass &volume, 
-		RigidBody* body = NULL);
-	~BVHNode();
+		RigidBody* body = NULL, int index = -1);
 
 	bool isLeaf() const;
-	bool overlaps(BVHNode<BoundingVolumeClass>* other) const;
+	bool overlaps(const BVHNode<BoundingVolumeClass>* other) const;
 	int getPotentialContacts(PotentialContact* contacts, int limit) const;
-	int getPotentialContactsWith(BVHNode<BoundingVolumeClass>* other,
+	int getPotentialContactsWith(const BVHNode<BoundingVolumeClass>* other,
 		PotentialContact* contacts, int limit) const;
-	void insert(RigidBody* newBdy, const BoundingVolumeClass &newVolume);
+	// refits this node and its ancestors, iteratively up to the root
 	void recalculateBoundingVolume(bool recurse = true);
 };
 
@@ -43,11 +55,161 @@ public:
 	real radius;
 
 public:
+	BoundingSphere();
 	BoundingSphere(const Vector2 &center, real radius);
 	BoundingSphere(const BoundingSphere &one, const BoundingSphere &other);
 	bool overlaps(const BoundingSphere *other) const;
+	real getSize() const;
 	real getGrowth(const BoundingSphere &other) const;
 };
 
+// axis-aligned bounding box
+struct BoundingBox
+{
+public:
+	Vector2 min;
+	Vector2 max;
+
+public:
+	BoundingBox();
+	BoundingBox(const Vector2 &min, const Vector2 &max);
+	BoundingBox(const BoundingBox &one, const BoundingBox &other);
+	bool overlaps(const BoundingBox *other) const;
+	bool contains(const BoundingBox &other) const;
+	real getSize() const; // perimeter
+	real getGrowth(const BoundingBox &other) const;
+};
+
+class Broadphase
+{
+public:
+	virtual ~Broadphase() {}
+	// boxes[i] bounds object i, each overlapping pair is written once
+	virtual int getPotentialContacts(const BoundingBox *boxes, int count,
+		PotentialPair *pairs, int limit) = 0;
+};
+
+// uniform grid hashed into a fixed table, rebuilt every call
+class SpatialHash : public Broadphase
+{
+protected:
+	struct Entry
+	{
+		int cellX;
+		int cellY;
+		int index;
+	};
+
+	real cellSize; // 0 picks twice the mean box extent each call
+	int tableSize; // power of two, upper bound on the buckets used
+	int bucketCount; // buckets used by the current call
+	std::vector<Entry> entries;
+	std::vector<Entry> sorted;
+	std::vector<int> bucketStart;
+
+protected:
+	int hash(int cellX, int cellY) const;
+	int cellOf(real coordinate, real inverseCellSize) const;
+
+public:
+	SpatialHash(real cellSize = 0, int tableSize = 4096);
+	void setCellSize(real cellSize);
+	real getCellSize() const;
+	virtual int getPotentialContacts(const BoundingBox *boxes, int count,
+		PotentialPair *pairs, int limit);
+};
+
+// Dynamic AABB tree. Leaves store boxes fattened by a margin so small
+// motions need no update; a leaf whose object leaves its fat box is
+// removed and reinserted. Insertion descends by the surface area
+// heuristic (perimeter in 2D). Used as a Broadphase it keeps one leaf per
+// index across calls and only touches the ones that moved.
+class BVHTree : public Broadphase
+{
+public:
+	typedef BVHNode<BoundingBox> Node;
+
+protected:
+	Node* root;
+	std::vector<Node*> leaves; // by index, NULL if not in the tree
+	std::vector<Node*> stack; // traversal scratch
+	real margin;
+
+protected:
+	void insertLeaf(Node* leaf);
+	void removeLeaf(Node* leaf);
+	BoundingBox fatten(const BoundingBox &box) const;
+
+public:
+	BVHTree(real margin = (real)0.02);
+	~BVHTree();
+
+	void insert(int index, const BoundingBox &box, RigidBody* body = NULL);
+	void remove(int index);
+	// returns true if the leaf had to be reinserted
+	bool update(int index, const BoundingBox &box);
+	void clear();
+
+	// accessor
+	const Node* getRoot() const;
+	int getHeight() const;
+
+	// every index whose fat box overlaps box, appended to result
+	void query(const BoundingBox &box, std::vector<int> &result);
+	virtual int getPotentialContacts(const BoundingBox *boxes, int count,
+		PotentialPair *pairs, int limit);
+};
+
+
+// Sweep and prune on one axis. The endpoint list stays sorted across
+// calls and is repaired by insertion sort, which is close to linear when
+// objects move little between frames. Pairs whose intervals overlap on the
+// sweep axis are kept in a persistent set updated by the endpoint swaps;
+// the ones whose boxes also overlap are reported, and the pairs that
+// started or stopped overlapping in the last call are kept as events.
+// Objects are identified by index, a change in count rebuilds the lists.
+class SweepAndPrune : public Broadphase
+{
+protected:
+	struct Endpoint
+	{
+		real value;
+		int index;
+		bool isMin;
+	};
+
+	struct Pair
+	{
+		int index[2]; // index[0] < index[1]
+		bool overlapping; // boxes overlap, not only the intervals
+	};
+
+	int axis; // 0 sweeps along x, 1 along y
+	std::vector<Endpoint> endpoints;
+	std::vector<Pair> intervalPairs;
+	HashTable pairTable; // pair key -> position in intervalPairs
+	std::vector<PotentialPair> added;
+	std::vector<PotentialPair> removed;
+	int objectCount;
+
+protected:
+	static bool less(const Endpoint &one, const Endpoint &other);
+	void addPair(int one, int other);
+	void removePair(int one, int other);
+	void rebuild(const BoundingBox *boxes, int count);
+
+public:
+	SweepAndPrune(int axis = 0);
+	void clear();
+
+	// accessor, events of the last getPotentialContacts
+	const std::vector<PotentialPair>& getAddedPairs() const;
+	const std::vector<PotentialPair>& getRemovedPairs() const;
+	int getIntervalPairCount() const;
+
+	virtual int getPotentialContacts(const BoundingBox *boxes, int count,
+		PotentialPair *pairs, int limit);
+};
+
 
 #endif // __COLLIDE_COARSE_H_INCLUDED__
\ No newline at end of file
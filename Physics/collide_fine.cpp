@@ -1,10 +1,16 @@
+#include <utility>
+
 #include "collide_fine.h"
+#include "simd.h"
 
 CollisionSphere::CollisionSphere()
-{}
+{
+	type = PRIMITIVE_SPHERE;
+}
 
 CollisionSphere::CollisionSphere(RigidBody *body, real radius)
 {
+	type = PRIMITIVE_SPHERE;
 	CollisionSphere::body = body;
 	CollisionSphere::radius = radius;
 }
@@ -19,14 +25,85 @@ CollisionPlane::CollisionPlane(const Vector2& normal, real offset)
 }
 
 CollisionBox::CollisionBox()
-{}
+{
+	type = PRIMITIVE_BOX;
+}
 
 CollisionBox::CollisionBox(RigidBody *body, const Vector2& halfSize)
 {
+	type = PRIMITIVE_BOX;
 	CollisionBox::body = body;
 	CollisionBox::halfSize = halfSize;
 }
 
+CollisionPolygon::CollisionPolygon()
+{
+	type = PRIMITIVE_POLYGON;
+	vertexCount = 0;
+}
+
+CollisionPolygon::CollisionPolygon(RigidBody *body, const Vector2 *vertices, int vertexCount)
+{
+	type = PRIMITIVE_POLYGON;
+	CollisionPolygon::body = body;
+	CollisionPolygon::vertexCount = 0;
+	bool valid = setVertices(vertices, vertexCount);
+	assert(valid);
+}
+
+bool CollisionPolygon::setVertices(const Vector2 *vertices, int vertexCount)
+{
+	// checked in every build: more vertices would overrun the arrays,
+	// and a zero-length edge has no normal
+	if (vertexCount < 3 || vertexCount > MAX_VERTICES)
+		return false;
+	for (int i = 0; i < vertexCount; i++)
+		if ((vertices[(i + 1) % vertexCount] - vertices[i]).squareMagnitude() == 0)
+			return false;
+
+	CollisionPolygon::vertexCount = vertexCount;
+	for (int i = 0; i < vertexCount; i++)
+		CollisionPolygon::vertices[i] = vertices[i];
+	for (int i = 0; i < vertexCount; i++)
+	{
+		Vector2 edge = vertices[(i + 1) % vertexCount] - vertices[i];
+		normals[i] = Vector2(edge.y, -edge.x).unit();
+	}
+	return true;
+}
+
+
+CollisionCompound::CollisionCompound()
+{
+	body = NULL;
+}
+
+CollisionCompound::CollisionCompound(RigidBody *body)
+{
+	CollisionCompound::body = body;
+}
+
+bool CollisionCompound::add(CollisionPrimitive *child, const Vector2 &position,
+	const Vector2 &orientation)
+{
+	// checked in every build: a 17th child's number would run into the
+	// other bits of the feature ids
+	if ((int)children.size() >= MAX_CHILDREN)
+		return false;
+
+	child->body = body;
+	child->offset.setOrientationAndPos(orientation, position);
+	children.push_back(child);
+	return true;
+}
+
+BoundingBox CollisionCompound::getBoundingBox() const
+{
+	BoundingBox box = children[0]->getBoundingBox();
+	for (size_t i = 1; i < children.size(); i++)
+		box = BoundingBox(box, children[i]->getBoundingBox());
+	return box;
+}
 
 CollisionData::CollisionData(int maxContact, real restitution, real friction)
 	: MAX_CONTACT(maxContact)
@@ -62,8 +139,8 @@ int CollisionDetector::sphereAndSphere(const CollisionSphere &one,
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	Vector2 positionOne = one.body->getPosition();
-	Vector2 positionTwo = two.body->getPosition();
+	Vector2 positionOne = one.getPosition();
+	Vector2 positionTwo = two.getPosition();
 	Vector2 v = positionOne - positionTwo;
 	real d = v.magnitude();
 	real penetration = one.radius + two.radius - d;
@@ -88,7 +165,7 @@ int CollisionDetector::sphereAndHalfSpace(const CollisionSphere &sphere,
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	Vector2 positionSphere = sphere.body->getPosition();
+	Vector2 positionSphere = sphere.getPosition();
 	Vector2 normal = plane.normal.unit();
 	real penetration = plane.offset + sphere.radius - positionSphere * normal;
 
@@ -105,13 +182,171 @@ int CollisionDetector::sphereAndHalfSpace(const CollisionSphere &sphere,
 	return 1;
 }
 
+void SphereColumns::clear()
+{
+	sphere.clear();
+	x.clear();
+	y.clear();
+	radius.clear();
+}
+
+void SphereColumns::add(const CollisionSphere *sphere)
+{
+	Vector2 center = sphere->getPosition();
+	SphereColumns::sphere.push_back(sphere);
+	x.push_back(center.x);
+	y.push_back(center.y);
+	radius.push_back(sphere->radius);
+}
+
+int SphereColumns::size() const
+{
+	return (int)sphere.size();
+}
+
+// Appends the overlapping pairs of [start, start + LANES) to survivors.
+// Every lane writes its index and the count only moves past the ones
+// that overlap, so there is no branch per pair.
+template<class Lane, int LANES>
+static int compactSpherePairs(const SphereColumns &spheres, const int *first,
+	const int *second, int start, int *survivors, int survivorCount)
+{
+	real x1[LANES], y1[LANES], r1[LANES], x2[LANES], y2[LANES], r2[LANES];
+	for (int l = 0; l < LANES; l++)
+	{
+		int a = first[start + l];
+		int b = second[start + l];
+		x1[l] = spheres.x[a];
+		y1[l] = spheres.y[a];
+		r1[l] = spheres.radius[a];
+		x2[l] = spheres.x[b];
+		y2[l] = spheres.y[b];
+		r2[l] = spheres.radius[b];
+	}
+
+	Lane tag = Lane();
+	Lane dx = simdSub(simdLoad(x1, tag), simdLoad(x2, tag));
+	Lane dy = simdSub(simdLoad(y1, tag), simdLoad(y2, tag));
+	Lane reach = simdAdd(simdLoad(r1, tag), simdLoad(r2, tag));
+	Lane distanceSquared = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+	int bits = simdBits(simdAnd(simdLess(distanceSquared, simdMul(reach, reach)),
+		simdGreater(distanceSquared, simdSet((real)0.0, tag))));
+
+	for (int l = 0; l < LANES; l++)
+	{
+		survivors[survivorCount] = start + l;
+		survivorCount += (bits >> l) & 1;
+	}
+	return survivorCount;
+}
+
+// as compactSpherePairs, spheres [start, start + LANES) against a plane
+template<class Lane, int LANES>
+static int compactSpheresOnPlane(const SphereColumns &spheres, const Vector2 &normal,
+	real offset, int start, int *survivors, int survivorCount)
+{
+	Lane tag = Lane();
+	Lane distance = simdAdd(simdMul(simdLoad(&spheres.x[start], tag), simdSet(normal.x, tag)),
+		simdMul(simdLoad(&spheres.y[start], tag), simdSet(normal.y, tag)));
+	Lane penetration = simdSub(simdAdd(simdSet(offset, tag),
+		simdLoad(&spheres.radius[start], tag)), distance);
+	int bits = simdBits(simdGreater(penetration, simdSet((real)0.0, tag)));
+
+	for (int l = 0; l < LANES; l++)
+	{
+		survivors[survivorCount] = start + l;
+		survivorCount += (bits >> l) & 1;
+	}
+	return survivorCount;
+}
+
+int CollisionDetector::sphereAndSphereBatch(const SphereColumns &spheres,
+	const int *first, const int *second, int pairCount,
+	int *survivors, CollisionData *data)
+{
+	if (data->contactsLeft <= 0)
+		return 0;
+
+	int survivorCount = 0;
+	int k = 0;
+	for (; k + SIMD_LANES <= pairCount; k += SIMD_LANES)
+		survivorCount = compactSpherePairs<SimdReal, SIMD_LANES>(spheres,
+			first, second, k, survivors, survivorCount);
+	for (; k < pairCount; k++)
+		survivorCount = compactSpherePairs<real, 1>(spheres,
+			first, second, k, survivors, survivorCount);
+
+	int used = 0;
+	for (int i = 0; i < survivorCount && data->contactsLeft > 0; i++)
+	{
+		int a = first[survivors[i]];
+		int b = second[survivors[i]];
+		Vector2 positionOne(spheres.x[a], spheres.y[a]);
+		Vector2 v(positionOne.x - spheres.x[b], positionOne.y - spheres.y[b]);
+		real d = v.magnitude();
+		real penetration = spheres.radius[a] + spheres.radius[b] - d;
+
+		// squared distances can round the other way right at the edge
+		if (penetration <= 0)
+			continue;
+
+		Vector2 normal(v.x / d, v.y / d);
+		Contact* contact = data->contacts;
+		contact->contactPoint = positionOne - normal * (spheres.radius[a] - penetration);
+		contact->contactNormal = normal;
+		contact->penetration = penetration;
+		contact->setBodyData(spheres.sphere[a]->body, spheres.sphere[b]->body,
+			data->friction, data->restitution);
+
+		data->addContacts(1);
+		used++;
+	}
+	return used;
+}
+
+int CollisionDetector::sphereAndHalfSpaceBatch(const SphereColumns &spheres,
+	const CollisionPlane &plane, int *survivors, CollisionData *data)
+{
+	if (data->contactsLeft <= 0)
+		return 0;
+
+	Vector2 normal = plane.normal.unit();
+	int sphereCount = spheres.size();
+	int survivorCount = 0;
+	int k = 0;
+	for (; k + SIMD_LANES <= sphereCount; k += SIMD_LANES)
+		survivorCount = compactSpheresOnPlane<SimdReal, SIMD_LANES>(spheres,
+			normal, plane.offset, k, survivors, survivorCount);
+	for (; k < sphereCount; k++)
+		survivorCount = compactSpheresOnPlane<real, 1>(spheres,
+			normal, plane.offset, k, survivors, survivorCount);
+
+	int used = 0;
+	for (int i = 0; i < survivorCount && data->contactsLeft > 0; i++)
+	{
+		int s = survivors[i];
+		Vector2 positionSphere(spheres.x[s], spheres.y[s]);
+		real penetration = plane.offset + spheres.radius[s] - positionSphere * normal;
+
+		Contact* contact = data->contacts;
+		contact->contactPoint = positionSphere - normal * (spheres.radius[s] - penetration);
+		contact->contactNormal = normal;
+		contact->penetration = penetration;
+		contact->setBodyData(spheres.sphere[s]->body, NULL, data->friction, data->restitution);
+
+		data->addContacts(1);
+		used++;
+	}
+	return used;
+}
+
 int CollisionDetector::sphereAndTruePlane(const CollisionSphere &sphere,
 	const CollisionPlane &plane, CollisionData *data)
 {
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	Vector2 positionSphere = sphere.body->getPosition();
+	Vector2 positionSphere = sphere.getPosition();
 	Vector2 normal = plane.normal.unit();
 	real distance = positionSphere * normal - plane.offset;
 	real penetration = sphere.radius - real_abs(distance);
@@ -148,12 +383,13 @@ int CollisionDetector::boxAndHalfSpace(const CollisionBox &box,
 		Vector2(-box.halfSize.x, +box.halfSize.y),
 		Vector2(-box.halfSize.x, -box.halfSize.y)
 	};
+	Matrix3 transform = box.getTransform();
 	Vector2 normal = plane.normal.unit();
 	int contactUsed = 0;
 
 	for (int i = 0; i < 4; i++)
 	{
-		Vector2 vertexPos = box.body->getTransformMatrix() * (vertices[i]);
+		Vector2 vertexPos = transform * (vertices[i]);
 		real penetration = plane.offset - vertexPos * normal;
 
 		if (penetration > -0.0)
@@ -163,6 +399,7 @@ int CollisionDetector::boxAndHalfSpace(const CollisionBox &box,
 			contact->contactNormal = normal;
 			contact->penetration = penetration;
 			contact->setBodyData(box.body, NULL, data->friction, data->restitution);
+			contact->feature = i;
 			data->addContacts(1);
 			contactUsed++;
 		}
@@ -176,8 +413,8 @@ int CollisionDetector::boxAndSphere(const CollisionBox &box,
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	Vector2 center = sphere.body->getPosition();
-	Vector2 relCenter = box.body->getPointInLocalSpace(center);
+	Vector2 center = sphere.getPosition();
+	Vector2 relCenter = box.getTransform().transformInverse(center);
 
 	real sizeX = real_abs(box.halfSize.x);
 	real sizeY = real_abs(box.halfSize.y);
@@ -194,7 +431,7 @@ int CollisionDetector::boxAndSphere(const CollisionBox &box,
 		return 0;
 
 	// does not handle if sphere is inside box
-	Vector2 closestPointWorld = box.body->getPointInWorldSpace(closestPoint);
+	Vector2 closestPointWorld = box.getTransform() * closestPoint;
 	Contact* contact = data->contacts;
 	contact->contactPoint = closestPointWorld;
 	contact->contactNormal = (closestPointWorld - center).unit();
@@ -211,14 +448,15 @@ int CollisionDetector::boxAndPoint(const CollisionBox &box,
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	Vector2 relPoint = box.body->getPointInLocalSpace(point);
+	Matrix3 transform = box.getTransform();
+	Vector2 relPoint = transform.transformInverse(point);
 	Vector2 normal;
 	real penetration;
 
 	real depthX = box.halfSize.x - real_abs(relPoint.x);
 	if (depthX <= 0) 
 		return 0;
-	normal = box.body->getTransformMatrix().getAxis(0) * -1;
+	normal = transform.getAxis(0) * -1;
 	if (relPoint.x < 0)
 		normal.invert();
 	penetration = depthX;
@@ -228,7 +466,7 @@ int CollisionDetector::boxAndPoint(const CollisionBox &box,
 		return 0;
 	else if (depthY < depthX)
 	{
-		normal = box.body->getTransformMatrix().getAxis(1) * -1;
+		normal = transform.getAxis(1) * -1;
 		if (relPoint.y < 0)
 			normal.invert();
 		penetration = depthY;
@@ -244,57 +482,201 @@ int CollisionDetector::boxAndPoint(const CollisionBox &box,
 	return 1;
 }
 
-// todo
+// Separation of the boxes along axes[index], positive if it separates
+// them; axes holds the axes of one, then of two
+static real boxSeparation(const Vector2 &halfOne, const Vector2 &halfTwo,
+	const Vector2 axes[4], const Vector2 &toCentre, int index)
+{
+	const Vector2 &axis = axes[index];
+	real reach =
+		halfOne.x * real_abs(axis * axes[0]) + halfOne.y * real_abs(axis * axes[1]) +
+		halfTwo.x * real_abs(axis * axes[2]) + halfTwo.y * real_abs(axis * axes[3]);
+	return real_abs(toCentre * axis) - reach;
+}
+
+// Clips the segment v[0], v[1] to the side normal * p <= offset, false
+// if all of it is outside
+static bool clipSegment(Vector2 v[2], const Vector2 &normal, real offset)
+{
+	real d0 = normal * v[0] - offset;
+	real d1 = normal * v[1] - offset;
+	if (d0 > 0 && d1 > 0)
+		return false;
+
+	if (d0 > 0 || d1 > 0)
+	{
+		Vector2 cut = v[0] + (v[1] - v[0]) * (d0 / (d0 - d1));
+		if (d0 > 0)
+			v[0] = cut;
+		else
+			v[1] = cut;
+	}
+	return true;
+}
+
 int CollisionDetector::boxAndBox(const CollisionBox &one,
-	const CollisionBox &two, CollisionData *data)
+	const CollisionBox &two, CollisionData *data, int *separatingAxis)
 {
 	if (data->contactsLeft <= 0)
 		return 0;
 
-	int contactUsed = 0;
-
-	Vector2 verticesOne[4] =
+	Matrix3 transform[2] = { one.getTransform(), two.getTransform() };
+	const CollisionBox *box[2] = { &one, &two };
+	Vector2 centre[2] = { transform[0].getAxis(2), transform[1].getAxis(2) };
+	Vector2 axes[4] =
 	{
-		Vector2(+one.halfSize.x, +one.halfSize.y),
-		Vector2(+one.halfSize.x, -one.halfSize.y),
-		Vector2(-one.halfSize.x, +one.halfSize.y),
-		Vector2(-one.halfSize.x, -one.halfSize.y)
+		transform[0].getAxis(0), transform[0].getAxis(1),
+		transform[1].getAxis(0), transform[1].getAxis(1)
 	};
+	Vector2 toCentre = centre[1] - centre[0];
+
+	// the axis that separated the pair last time most likely still does
+	if (separatingAxis && *separatingAxis >= 0 && *separatingAxis < 4 &&
+		boxSeparation(one.halfSize, two.halfSize, axes, toCentre, *separatingAxis) > 0)
+		return 0;
+
+	real separation[4];
 	for (int i = 0; i < 4; i++)
 	{
-		Vector2 vertexPos = one.body->getTransformMatrix() * (verticesOne[i]);
-		int contact = boxAndPoint(two, vertexPos, data);
-		if (contact == 1)
+		separation[i] = boxSeparation(one.halfSize, two.halfSize, axes, toCentre, i);
+		if (separation[i] > 0)
 		{
-			data->contactArray[data->contactsCount - 1].body[1] = one.body;
-			contactUsed ++;
+			if (separatingAxis)
+				*separatingAxis = i;
+			return 0;
 		}
 	}
-
-	Vector2 verticesTwo[4] =
+	if (separatingAxis)
+		*separatingAxis = -1;
+
+	// The reference face is on the axis of least penetration. Box one
+	// keeps it unless two is clearly better, so nearly equal axes do not
+	// swap the reference, and the contact ids, from frame to frame.
+	int bestOne = separation[0] > separation[1] ? 0 : 1;
+	int bestTwo = separation[2] > separation[3] ? 2 : 3;
+	int reference = 0;
+	int referenceAxis = bestOne;
+	if (separation[bestTwo] > (real)0.98 * separation[bestOne] + (real)0.001)
 	{
-		Vector2(+two.halfSize.x, +two.halfSize.y),
-		Vector2(+two.halfSize.x, -two.halfSize.y),
-		Vector2(-two.halfSize.x, +two.halfSize.y),
-		Vector2(-two.halfSize.x, -two.halfSize.y)
-	};
-	for (int i = 0; i < 4; i++)
+		reference = 1;
+		referenceAxis = bestTwo - 2;
+	}
+	int incident = 1 - reference;
+	const CollisionBox &referenceBox = *box[reference];
+	const CollisionBox &incidentBox = *box[incident];
+	real referenceHalf[2] = { referenceBox.halfSize.x, referenceBox.halfSize.y };
+	real incidentHalf[2] = { incidentBox.halfSize.x, incidentBox.halfSize.y };
+
+	// face normal from the reference box towards the incident one
+	Vector2 normal = axes[2 * reference + referenceAxis];
+	Vector2 toIncident = reference == 0 ? toCentre : toCentre * -1;
+	int referenceSide = 0;
+	if (normal * toIncident < 0)
 	{
-		Vector2 vertexPos = two.body->getTransformMatrix() * (verticesTwo[i]);
-		int contact = boxAndPoint(one, vertexPos, data);
-		if (contact == 1)
-		{
-			data->contactArray[data->contactsCount - 1].body[1] = two.body;
-			contactUsed++;
-		}
+		normal.invert();
+		referenceSide = 1;
+	}
+	Vector2 tangent = axes[2 * reference + 1 - referenceAxis];
+	real tangentHalf = referenceHalf[1 - referenceAxis];
+
+	// the incident edge is the face of the other box that faces most
+	// against the normal
+	int incidentAxis = real_abs(normal * axes[2 * incident]) >
+		real_abs(normal * axes[2 * incident + 1]) ? 0 : 1;
+	Vector2 incidentNormal = axes[2 * incident + incidentAxis];
+	int incidentSide = 0;
+	if (incidentNormal * normal > 0)
+	{
+		incidentNormal.invert();
+		incidentSide = 1;
 	}
+	Vector2 edgeCentre = centre[incident] + incidentNormal * incidentHalf[incidentAxis];
+	Vector2 edge = axes[2 * incident + 1 - incidentAxis] * incidentHalf[1 - incidentAxis];
+	Vector2 v[2] = { edgeCentre + edge, edgeCentre - edge };
 
+	// clip it to the sides of the reference face
+	real tangentOffset = tangent * centre[reference];
+	if (!clipSegment(v, tangent, tangentOffset + tangentHalf))
+		return 0;
+	if (!clipSegment(v, tangent * -1, tangentHalf - tangentOffset))
+		return 0;
+
+	// and keep the points below the reference face
+	real faceOffset = normal * centre[reference] + referenceHalf[referenceAxis];
+	unsigned feature = referenceAxis | (referenceSide << 1) | (reference << 2) |
+		(incidentAxis << 3) | (incidentSide << 4);
+	int contactUsed = 0;
+	for (int k = 0; k < 2 && data->contactsLeft > 0; k++)
+	{
+		real penetration = faceOffset - normal * v[k];
+		if (penetration < 0)
+			continue;
+
+		Contact* contact = data->contacts;
+		contact->contactPoint = v[k];
+		contact->contactNormal = normal * -1;
+		contact->penetration = penetration;
+		contact->setBodyData(referenceBox.body, incidentBox.body,
+			data->friction, data->restitution);
+		contact->feature = feature | (k << 5);
+		data->addContacts(1);
+		contactUsed++;
+	}
 	return contactUsed;
 }
 
+Matrix3 CollisionPrimitive::getTransform() const
+{
+	return body->getTransformMatrix() * offset;
+}
+
+Vector2 CollisionPrimitive::getPosition() const
+{
+	return getTransform().getAxis(2);
+}
+
 Vector2 CollisionPrimitive::getAxis(unsigned index) const
 {
-	return body->getTransformMatrix().getAxis(index);
+	return getTransform().getAxis(index);
+}
+
+BoundingBox CollisionPrimitive::getBoundingBox() const
+{
+	if (type == PRIMITIVE_POLYGON)
+	{
+		const CollisionPolygon *polygon = static_cast<const CollisionPolygon*>(this);
+		Matrix3 transform = getTransform();
+		Vector2 lower = transform * polygon->vertices[0];
+		Vector2 upper = lower;
+		for (int i = 1; i < polygon->vertexCount; i++)
+		{
+			Vector2 vertex = transform * polygon->vertices[i];
+			lower.x = real_fmin(lower.x, vertex.x);
+			lower.y = real_fmin(lower.y, vertex.y);
+			upper.x = real_fmax(upper.x, vertex.x);
+			upper.y = real_fmax(upper.y, vertex.y);
+		}
+		return BoundingBox(lower, upper);
+	}
+
+	Vector2 center = getPosition();
+	Vector2 extent;
+
+	if (type == PRIMITIVE_SPHERE)
+	{
+		real radius = static_cast<const CollisionSphere*>(this)->radius;
+		extent = Vector2(radius, radius);
+	}
+	else
+	{
+		Vector2 halfSize = static_cast<const CollisionBox*>(this)->halfSize;
+		Vector2 axisX = getAxis(0);
+		Vector2 axisY = getAxis(1);
+		extent.x = real_abs(axisX.x) * halfSize.x + real_abs(axisY.x) * halfSize.y;
+		extent.y = real_abs(axisX.y) * halfSize.x + real_abs(axisY.y) * halfSize.y;
+	}
+
+	return BoundingBox(center - extent, center + extent);
 }
 
 static inline real transformToAxis(
@@ -377,9 +759,11 @@ void fillPointFaceBoxBox(
 	// but we need to work out which of the two faces on
 	// this axis.
 	Vector2 normal = one.getAxis(best);
+	bool flipped = false;
 	if (one.getAxis(best) * toCentre > 0)
 	{
 		normal = normal * -1.0f;
+		flipped = true;
 	}
 
 	// Work out which vertex of box two we're colliding with.
@@ -391,9 +775,11 @@ void fillPointFaceBoxBox(
 	// Create the contact data
 	contact->contactNormal = normal;
 	contact->penetration = pen;
-	contact->contactPoint = two.body->getTransformMatrix() * vertex;
+	contact->contactPoint = two.getTransform() * vertex;
 	contact->setBodyData(one.body, two.body,
 		data->friction, data->restitution);
+	// face of one (axis, side) and vertex of two (signs)
+	contact->feature = best | (flipped ? 2 : 0) | (vertex.x < 0 ? 4 : 0) | (vertex.y < 0 ? 8 : 0);
 }
 
 // This preprocessor definition is only used as a convenience
@@ -457,4 +843,772 @@ unsigned CollisionDetector::boxAndBox2(
 
 	return 0;
 }
-#undef CHECK_OVERLAP
\ No newline at end of file
+#undef CHECK_OVERLAP
+
+// World vertices and edge normals of a box or polygon, counter-clockwise
+// as in CollisionPolygon; returns the vertex count
+static int worldPolygon(const CollisionPrimitive &primitive,
+	Vector2 *vertices, Vector2 *normals)
+{
+	Matrix3 transform = primitive.getTransform();
+	if (primitive.type == PRIMITIVE_BOX)
+	{
+		Vector2 halfSize = static_cast<const CollisionBox&>(primitive).halfSize;
+		Vector2 corners[4] =
+		{
+			Vector2(-halfSize.x, -halfSize.y),
+			Vector2(+halfSize.x, -halfSize.y),
+			Vector2(+halfSize.x, +halfSize.y),
+			Vector2(-halfSize.x, +halfSize.y)
+		};
+		Vector2 sides[4] = { Vector2(0, -1), Vector2(1, 0), Vector2(0, 1), Vector2(-1, 0) };
+		for (int i = 0; i < 4; i++)
+		{
+			vertices[i] = transform * corners[i];
+			normals[i] = transform.transformDirection(sides[i]);
+		}
+		return 4;
+	}
+
+	const CollisionPolygon &polygon = static_cast<const CollisionPolygon&>(primitive);
+	for (int i = 0; i < polygon.vertexCount; i++)
+	{
+		vertices[i] = transform * polygon.vertices[i];
+		normals[i] = transform.transformDirection(polygon.normals[i]);
+	}
+	return polygon.vertexCount;
+}
+
+// Largest separation of two from one over the edge normals of one,
+// the edge it is on in edge
+static real maxSeparation(const Vector2 *verticesOne, const Vector2 *normalsOne,
+	int countOne, const Vector2 *verticesTwo, int countTwo, int &edge)
+{
+	real best = -REAL_MAX;
+	edge = 0;
+	for (int i = 0; i < countOne; i++)
+	{
+		// deepest vertex of two below edge i
+		real deepest = REAL_MAX;
+		for (int j = 0; j < countTwo; j++)
+			deepest = real_fmin(deepest, normalsOne[i] * (verticesTwo[j] - verticesOne[i]));
+		if (deepest > best)
+		{
+			best = deepest;
+			edge = i;
+		}
+	}
+	return best;
+}
+
+// polygonAndPolygon on world vertices, for polygons and boxes alike
+static int convexAndConvex(const CollisionPrimitive &one, const CollisionPrimitive &two,
+	CollisionData *data)
+{
+	if (data->contactsLeft <= 0)
+		return 0;
+
+	Vector2 vertices[2][CollisionPolygon::MAX_VERTICES];
+	Vector2 normals[2][CollisionPolygon::MAX_VERTICES];
+	int count[2];
+	count[0] = worldPolygon(one, vertices[0], normals[0]);
+	count[1] = worldPolygon(two, vertices[1], normals[1]);
+
+	int edgeOne, edgeTwo;
+	real separationOne = maxSeparation(vertices[0], normals[0], count[0],
+		vertices[1], count[1], edgeOne);
+	if (separationOne > 0)
+		return 0;
+	real separationTwo = maxSeparation(vertices[1], normals[1], count[1],
+		vertices[0], count[0], edgeTwo);
+	if (separationTwo > 0)
+		return 0;
+
+	// biased towards one as in boxAndBox
+	int reference = 0;
+	int referenceEdge = edgeOne;
+	if (separationTwo > (real)0.98 * separationOne + (real)0.001)
+	{
+		reference = 1;
+		referenceEdge = edgeTwo;
+	}
+	int incident = 1 - reference;
+
+	const Vector2 *referenceVertices = vertices[reference];
+	int referenceCount = count[reference];
+	Vector2 normal = normals[reference][referenceEdge];
+	Vector2 v1 = referenceVertices[referenceEdge];
+	Vector2 v2 = referenceVertices[(referenceEdge + 1) % referenceCount];
+
+	// incident edge, the one facing most against the normal
+	int incidentEdge = 0;
+	real lowest = REAL_MAX;
+	for (int i = 0; i < count[incident]; i++)
+	{
+		real facing = normals[incident][i] * normal;
+		if (facing < lowest)
+		{
+			lowest = facing;
+			incidentEdge = i;
+		}
+	}
+	Vector2 v[2] =
+	{
+		vertices[incident][incidentEdge],
+		vertices[incident][(incidentEdge + 1) % count[incident]]
+	};
+
+	// clip it to the sides of the reference edge
+	Vector2 tangent = (v2 - v1).unit();
+	if (!clipSegment(v, tangent * -1, tangent * v1 * -1))
+		return 0;
+	if (!clipSegment(v, tangent, tangent * v2))
+		return 0;
+
+	real faceOffset = normal * v1;
+	RigidBody *bodies[2] = { one.body, two.body };
+	unsigned feature = referenceEdge | (reference << 3) | (incidentEdge << 4);
+	int contactUsed = 0;
+	for (int k = 0; k < 2 && data->contactsLeft > 0; k++)
+	{
+		real penetration = faceOffset - normal * v[k];
+		if (penetration < 0)
+			continue;
+
+		Contact* contact = data->contacts;
+		contact->contactPoint = v[k];
+		contact->contactNormal = normal * -1;
+		contact->penetration = penetration;
+		contact->setBodyData(bodies[reference], bodies[incident],
+			data->friction, data->restitution);
+		contact->feature = feature | (k << 7);
+		data->addContacts(1);
+		contactUsed++;
+	}
+	return contactUsed;
+}
+
+int CollisionDetector::polygonAndPolygon(const CollisionPolygon &one,
+	const CollisionPolygon &two, CollisionData *data)
+{
+	return convexAndConvex(one, two, data);
+}
+
+int CollisionDetector::polygonAndBox(const CollisionPolygon &polygon,
+	const CollisionBox &box, CollisionData *data)
+{
+	return convexAndConvex(polygon, box, data);
+}
+
+// Signed distance from point to the outline of world vertices and
+// normals, negative inside; also the closest point on the outline, the
+// outward normal there and the edge it is on
+static real outlineDistance(const Vector2 *vertices, const Vector2 *normals, int count,
+	const Vector2 &point, Vector2 &closestPoint, Vector2 &normal, int &edge)
+{
+	// the edge the point is furthest out of
+	edge = 0;
+	real separation = -REAL_MAX;
+	for (int i = 0; i < count; i++)
+	{
+		real s = normals[i] * (point - vertices[i]);
+		if (s > separation)
+		{
+			separation = s;
+			edge = i;
+		}
+	}
+
+	// closest point on the outline: on the edge, or past one of its
+	// ends (only possible from outside) the vertex there
+	Vector2 v1 = vertices[edge];
+	Vector2 v2 = vertices[(edge + 1) % count];
+	normal = normals[edge];
+	closestPoint = point - normal * separation;
+	if (separation <= 0)
+		return separation;
+
+	if ((point - v1) * (v2 - v1) <= 0)
+		closestPoint = v1;
+	else if ((point - v2) * (v1 - v2) <= 0)
+		closestPoint = v2;
+	else
+		return separation;
+
+	real distance = (point - closestPoint).magnitude();
+	normal = (point - closestPoint) * ((real)1.0 / distance);
+	return distance;
+}
+
+int CollisionDetector::polygonAndSphere(const CollisionPolygon &polygon,
+	const CollisionSphere &sphere, CollisionData *data)
+{
+	if (data->contactsLeft <= 0)
+		return 0;
+
+	Vector2 vertices[CollisionPolygon::MAX_VERTICES];
+	Vector2 normals[CollisionPolygon::MAX_VERTICES];
+	int count = worldPolygon(polygon, vertices, normals);
+
+	Vector2 closestPoint, normal;
+	int edge;
+	real distance = outlineDistance(vertices, normals, count, sphere.getPosition(),
+		closestPoint, normal, edge);
+	if (distance >= sphere.radius)
+		return 0;
+
+	Contact* contact = data->contacts;
+	contact->contactPoint = closestPoint;
+	contact->contactNormal = normal * -1;
+	contact->penetration = sphere.radius - distance;
+	contact->setBodyData(polygon.body, sphere.body, data->friction, data->restitution);
+	contact->feature = edge;
+
+	data->addContacts(1);
+	return 1;
+}
+
+int CollisionDetector::polygonAndHalfSpace(const CollisionPolygon &polygon,
+	const CollisionPlane &plane, CollisionData *data)
+{
+	if (data->contactsLeft <= 0)
+		return 0;
+
+	Matrix3 transform = polygon.getTransform();
+	Vector2 normal = plane.normal.unit();
+	int contactUsed = 0;
+
+	for (int i = 0; i < polygon.vertexCount && data->contactsLeft > 0; i++)
+	{
+		Vector2 vertexPos = transform * polygon.vertices[i];
+		real penetration = plane.offset - vertexPos * normal;
+
+		if (penetration > -0.0)
+		{
+			Contact* contact = data->contacts;
+			contact->contactPoint = vertexPos + normal * (penetration);
+			contact->contactNormal = normal;
+			contact->penetration = penetration;
+			contact->setBodyData(polygon.body, NULL, data->friction, data->restitution);
+			contact->feature = i;
+			data->addContacts(1);
+			contactUsed++;
+		}
+	}
+	return contactUsed;
+}
+
+real CollisionDetector::primitiveGap(const CollisionPrimitive &one,
+	const CollisionPrimitive &two)
+{
+	if (one.type == PRIMITIVE_SPHERE && two.type == PRIMITIVE_SPHERE)
+		return (one.getPosition() - two.getPosition()).magnitude() -
+			static_cast<const CollisionSphere&>(one).radius -
+			static_cast<const CollisionSphere&>(two).radius;
+
+	if (one.type == PRIMITIVE_SPHERE || two.type == PRIMITIVE_SPHERE)
+	{
+		bool sphereFirst = one.type == PRIMITIVE_SPHERE;
+		const CollisionSphere &sphere =
+			static_cast<const CollisionSphere&>(sphereFirst ? one : two);
+		Vector2 vertices[CollisionPolygon::MAX_VERTICES];
+		Vector2 normals[CollisionPolygon::MAX_VERTICES];
+		int count = worldPolygon(sphereFirst ? two : one, vertices, normals);
+
+		Vector2 closestPoint, normal;
+		int edge;
+		return outlineDistance(vertices, normals, count, sphere.getPosition(),
+			closestPoint, normal, edge) - sphere.radius;
+	}
+
+	// separation on the edge normals: 2D SAT, so positive exactly when
+	// apart, but short of the distance across corners
+	Vector2 vertices[2][CollisionPolygon::MAX_VERTICES];
+	Vector2 normals[2][CollisionPolygon::MAX_VERTICES];
+	int count[2];
+	count[0] = worldPolygon(one, vertices[0], normals[0]);
+	count[1] = worldPolygon(two, vertices[1], normals[1]);
+	int edge;
+	return real_fmax(
+		maxSeparation(vertices[0], normals[0], count[0], vertices[1], count[1], edge),
+		maxSeparation(vertices[1], normals[1], count[1], vertices[0], count[0], edge));
+}
+
+real CollisionDetector::halfSpaceGap(const CollisionPrimitive &primitive,
+	const CollisionPlane &plane)
+{
+	Vector2 normal = plane.normal.unit();
+	if (primitive.type == PRIMITIVE_SPHERE)
+		return primitive.getPosition() * normal - plane.offset -
+			static_cast<const CollisionSphere&>(primitive).radius;
+
+	Vector2 vertices[CollisionPolygon::MAX_VERTICES];
+	Vector2 normals[CollisionPolygon::MAX_VERTICES];
+	int count = worldPolygon(primitive, vertices, normals);
+	real gap = REAL_MAX;
+	for (int i = 0; i < count; i++)
+		gap = real_fmin(gap, vertices[i] * normal - plane.offset);
+	return gap;
+}
+
+int CollisionDetector::primitiveAndPrimitive(const CollisionPrimitive &one,
+	const CollisionPrimitive &two, CollisionData *data)
+{
+	if (one.type == PRIMITIVE_POLYGON || two.type == PRIMITIVE_POLYGON)
+	{
+		bool polygonFirst = one.type == PRIMITIVE_POLYGON;
+		const CollisionPolygon &polygon =
+			static_cast<const CollisionPolygon&>(polygonFirst ? one : two);
+		const CollisionPrimitive &other = polygonFirst ? two : one;
+		if (other.type == PRIMITIVE_SPHERE)
+			return polygonAndSphere(polygon, static_cast<const CollisionSphere&>(other), data);
+		if (other.type == PRIMITIVE_BOX)
+			return polygonAndBox(polygon, static_cast<const CollisionBox&>(other), data);
+		return polygonAndPolygon(polygon, static_cast<const CollisionPolygon&>(other), data);
+	}
+
+	if (one.type == PRIMITIVE_SPHERE)
+	{
+		const CollisionSphere &sphere = static_cast<const CollisionSphere&>(one);
+		if (two.type == PRIMITIVE_SPHERE)
+			return sphereAndSphere(sphere,
+				static_cast<const CollisionSphere&>(two), data);
+		return boxAndSphere(static_cast<const CollisionBox&>(two), sphere, data);
+	}
+
+	const CollisionBox &box = static_cast<const CollisionBox&>(one);
+	if (two.type == PRIMITIVE_SPHERE)
+		return boxAndSphere(box, static_cast<const CollisionSphere&>(two), data);
+	return boxAndBox(box, static_cast<const CollisionBox&>(two), data);
+}
+
+int CollisionDetector::primitiveAndHalfSpace(const CollisionPrimitive &primitive,
+	const CollisionPlane &plane, CollisionData *data)
+{
+	if (primitive.type == PRIMITIVE_SPHERE)
+		return sphereAndHalfSpace(static_cast<const CollisionSphere&>(primitive),
+			plane, data);
+	if (primitive.type == PRIMITIVE_POLYGON)
+		return polygonAndHalfSpace(static_cast<const CollisionPolygon&>(primitive),
+			plane, data);
+	return boxAndHalfSpace(static_cast<const CollisionBox&>(primitive), plane, data);
+}
+
+
+CollisionSpace::CollisionSpace()
+{
+	broadphase = &spatialHash;
+	pairCount = 0;
+}
+
+void CollisionSpace::add(CollisionPrimitive *primitive,
+	unsigned category, unsigned mask)
+{
+	Entry entry = { primitive->body, (int)shapes.size(), 1, category, mask };
+	entries.push_back(entry);
+	shapes.push_back(primitive);
+}
+
+void CollisionSpace::add(CollisionCompound *compound,
+	unsigned category, unsigned mask)
+{
+	assert(!compound->children.empty());
+
+	Entry entry = { compound->body, (int)shapes.size(), (int)compound->children.size(),
+		category, mask };
+	entries.push_back(entry);
+	shapes.insert(shapes.end(), compound->children.begin(), compound->children.end());
+}
+
+void CollisionSpace::addPlane(CollisionPlane *plane)
+{
+	planes.push_back(plane);
+}
+
+void CollisionSpace::clear()
+{
+	entries.clear();
+	shapes.clear();
+	planes.clear();
+	pairCount = 0;
+	lastAxes.clear();
+	bulletPoses.clear();
+}
+
+void CollisionSpace::setBroadphase(Broadphase *broadphase)
+{
+	if (broadphase == NULL)
+		broadphase = &spatialHash;
+	this->broadphase = broadphase;
+}
+
+void CollisionSpace::generateShapeContacts(int one, int other, CollisionData *data)
+{
+	if (sphereOf[one] >= 0 && sphereOf[other] >= 0)
+	{
+		sphereFirst.push_back(sphereOf[one]);
+		sphereSecond.push_back(sphereOf[other]);
+		return;
+	}
+
+	const CollisionPrimitive &shapeOne = *shapes[one];
+	const CollisionPrimitive &shapeTwo = *shapes[other];
+	if (shapeOne.type == PRIMITIVE_BOX && shapeTwo.type == PRIMITIVE_BOX)
+	{
+		HashTable::Key key = HashTable::makeKey(one, other);
+		int axis = lastAxes.find(key);
+		CollisionDetector::boxAndBox(static_cast<const CollisionBox&>(shapeOne),
+			static_cast<const CollisionBox&>(shapeTwo), data, &axis);
+		if (axis >= 0)
+			nextAxes.insert(key, axis);
+		return;
+	}
+	CollisionDetector::primitiveAndPrimitive(shapeOne, shapeTwo, data);
+}
+
+int CollisionSpace::generateContacts(CollisionData *data)
+{
+	int before = data->contactsCount;
+	int count = (int)entries.size();
+	int shapeCount = (int)shapes.size();
+
+	shapeBoxes.resize(shapeCount);
+	for (int s = 0; s < shapeCount; s++)
+		shapeBoxes[s] = shapes[s]->getBoundingBox();
+	boxes.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		const Entry &entry = entries[i];
+		boxes[i] = shapeBoxes[entry.firstShape];
+		for (int s = 1; s < entry.shapeCount; s++)
+			boxes[i] = BoundingBox(boxes[i], shapeBoxes[entry.firstShape + s]);
+	}
+
+	// grow the pair buffer until the broadphase fits in it
+	if (pairs.size() < (size_t)count + 1)
+		pairs.resize(count + 1);
+	while (true)
+	{
+		pairCount = broadphase->getPotentialContacts(count > 0 ? &boxes[0] : NULL,
+			count, &pairs[0], (int)pairs.size());
+		if (pairCount < (int)pairs.size())
+			break;
+		pairs.resize(pairs.size() * 2);
+	}
+
+	// spheres on their own go to the batch kernels; compound children are
+	// tested one at a time, their contacts get the child in the feature id
+	spheres.clear();
+	sphereOf.assign(shapeCount, -1);
+	for (int i = 0; i < count; i++)
+	{
+		const Entry &entry = entries[i];
+		const CollisionPrimitive *shape = shapes[entry.firstShape];
+		if (entry.shapeCount == 1 && shape->type == PRIMITIVE_SPHERE)
+		{
+			sphereOf[entry.firstShape] = spheres.size();
+			spheres.add(static_cast<const CollisionSphere*>(shape));
+		}
+	}
+
+	// sphere pairs are only gathered here and tested together below
+	sphereFirst.clear();
+	sphereSecond.clear();
+	for (int i = 0; i < pairCount; i++)
+	{
+		const Entry &one = entries[pairs[i].index[0]];
+		const Entry &two = entries[pairs[i].index[1]];
+
+		if (!(one.category & two.mask) || !(two.category & one.mask))
+			continue;
+		if (one.body == two.body)
+			continue;
+
+		if (one.shapeCount == 1 && two.shapeCount == 1)
+		{
+			generateShapeContacts(one.firstShape, two.firstShape, data);
+			continue;
+		}
+
+		// mid-phase, only the children whose boxes overlap
+		for (int a = 0; a < one.shapeCount; a++)
+		{
+			int shapeOne = one.firstShape + a;
+			for (int b = 0; b < two.shapeCount; b++)
+			{
+				int shapeTwo = two.firstShape + b;
+				if (!shapeBoxes[shapeOne].overlaps(&shapeBoxes[shapeTwo]))
+					continue;
+
+				Contact *first = data->contacts;
+				generateShapeContacts(shapeOne, shapeTwo, data);
+				for (Contact *c = first; c < data->contacts; c++)
+					c->feature |= (unsigned)((a & 15) << 8 | (b & 15) << 12);
+			}
+		}
+	}
+	std::swap(lastAxes, nextAxes);
+	nextAxes.clear();
+
+	int sphereCount = spheres.size();
+	int spherePairCount = (int)sphereFirst.size();
+	survivors.resize(spherePairCount > sphereCount ? spherePairCount : sphereCount);
+	if (spherePairCount > 0)
+		CollisionDetector::sphereAndSphereBatch(spheres, &sphereFirst[0],
+			&sphereSecond[0], spherePairCount, &survivors[0], data);
+
+	// the plane goes into the feature id, so the same vertex on two
+	// planes gives two contacts the resolver can tell apart
+	for (size_t p = 0; p < planes.size(); p++)
+	{
+		Contact *first = data->contacts;
+		if (sphereCount > 0)
+			CollisionDetector::sphereAndHalfSpaceBatch(spheres, *planes[p],
+				&survivors[0], data);
+		for (int i = 0; i < count; i++)
+		{
+			const Entry &entry = entries[i];
+			for (int s = 0; s < entry.shapeCount; s++)
+			{
+				int shape = entry.firstShape + s;
+				if (sphereOf[shape] >= 0)
+					continue;
+
+				Contact *shapeFirst = data->contacts;
+				CollisionDetector::primitiveAndHalfSpace(*shapes[shape], *planes[p], data);
+				for (Contact *c = shapeFirst; c < data->contacts; c++)
+					c->feature |= (unsigned)(s & 15) << 8;
+			}
+		}
+
+		for (Contact *c = first; c < data->contacts; c++)
+			c->feature |= (unsigned)(p + 1) << 16;
+	}
+
+	return data->contactsCount - before;
+}
+
+// sweepBullets advances to this far inside the first hit, so the
+// contact is found, and gives up on a sweep after so many steps
+static const real BULLET_OVERLAP = (real)0.002;
+static const int BULLET_ITERATIONS = 32;
+
+// distance from the body's origin to the furthest point of the shape
+static real shapeReach(const CollisionPrimitive &shape)
+{
+	real extent = 0;
+	if (shape.type == PRIMITIVE_SPHERE)
+		extent = static_cast<const CollisionSphere&>(shape).radius;
+	else if (shape.type == PRIMITIVE_BOX)
+		extent = static_cast<const CollisionBox&>(shape).halfSize.magnitude();
+	else
+	{
+		const CollisionPolygon &polygon = static_cast<const CollisionPolygon&>(shape);
+		for (int i = 0; i < polygon.vertexCount; i++)
+			extent = real_fmax(extent, polygon.vertices[i].magnitude());
+	}
+	return shape.offset.getAxis(2).magnitude() + extent;
+}
+
+real CollisionSpace::entryGap(const Entry &one, const Entry &two) const
+{
+	real gap = REAL_MAX;
+	for (int a = 0; a < one.shapeCount; a++)
+		for (int b = 0; b < two.shapeCount; b++)
+			gap = real_fmin(gap, CollisionDetector::primitiveGap(
+				*shapes[one.firstShape + a], *shapes[two.firstShape + b]));
+	return gap;
+}
+
+real CollisionSpace::entryGap(const Entry &entry, const CollisionPlane &plane) const
+{
+	real gap = REAL_MAX;
+	for (int s = 0; s < entry.shapeCount; s++)
+		gap = real_fmin(gap, CollisionDetector::halfSpaceGap(
+			*shapes[entry.firstShape + s], plane));
+	return gap;
+}
+
+void CollisionSpace::setBulletPose(const BulletPose &pose, real t)
+{
+	BodyStore &store = *entries[pose.entry].body->getStore();
+	unsigned slot = entries[pose.entry].body->getHandle().index;
+	if (t >= 1)
+	{
+		store.setPosition(slot, pose.endPosition);
+		store.setOrientation(slot, pose.endOrientation);
+		store.transformMatrix[slot] = pose.endTransform;
+		return;
+	}
+
+	Vector2 turned = pose.orientation;
+	turned.rotate(pose.angle * t);
+	store.setPosition(slot, pose.position + pose.motion * t);
+	store.setOrientation(slot, turned);
+	store.calculateDerivedData(slot);
+}
+
+void CollisionSpace::storeBulletPoses()
+{
+	bulletPoses.clear();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const RigidBody *body = entries[i].body;
+		if (!body->getIsBullet() || !body->getIsAwake())
+			continue;
+
+		BulletPose pose;
+		pose.entry = (int)i;
+		pose.position = body->getPosition();
+		pose.orientation = body->getOrientation();
+		bulletPoses.push_back(pose);
+	}
+}
+
+int CollisionSpace::sweepBullets()
+{
+	bulletOf.assign(entries.size(), -1);
+	for (size_t b = 0; b < bulletPoses.size(); b++)
+	{
+		BulletPose &pose = bulletPoses[b];
+		const Entry &bullet = entries[pose.entry];
+		// its box still holds what is left of the sweep
+		pose.endPosition = bullet.body->getPosition();
+		pose.endOrientation = bullet.body->getOrientation();
+		pose.endTransform = bullet.body->getTransformMatrix();
+
+		pose.motion = pose.endPosition - pose.position;
+		pose.angle = real_atan2(pose.orientation.crossProduct(pose.endOrientation),
+			pose.orientation * pose.endOrientation);
+		real reach = 0;
+		for (int s = 0; s < bullet.shapeCount; s++)
+			reach = real_fmax(reach, shapeReach(*shapes[bullet.firstShape + s]));
+		pose.bound = pose.motion.magnitude() + real_abs(pose.angle) * reach;
+		bulletOf[pose.entry] = (int)b;
+	}
+
+	// the boxes around the end poses, grown by the bounds, hold the
+	// sweeps; generateContacts builds its own
+	boxes.resize(entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const Entry &entry = entries[i];
+		boxes[i] = shapes[entry.firstShape]->getBoundingBox();
+		for (int s = 1; s < entry.shapeCount; s++)
+			boxes[i] = BoundingBox(boxes[i], shapes[entry.firstShape + s]->getBoundingBox());
+		if (bulletOf[i] >= 0)
+		{
+			Vector2 grow(bulletPoses[bulletOf[i]].bound, bulletPoses[bulletOf[i]].bound);
+			boxes[i] = BoundingBox(boxes[i].min - grow, boxes[i].max + grow);
+		}
+	}
+
+	int swept = 0;
+	for (size_t b = 0; b < bulletPoses.size(); b++)
+	{
+		BulletPose &pose = bulletPoses[b];
+		const Entry &bullet = entries[pose.entry];
+		if (pose.bound <= BULLET_OVERLAP)
+			continue;
+
+		bulletEntries.clear();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const Entry &other = entries[i];
+			if (other.body == bullet.body)
+				continue;
+			if (!(bullet.category & other.mask) || !(other.category & bullet.mask))
+				continue;
+			if (boxes[pose.entry].overlaps(&boxes[i]))
+			{
+				BulletTarget target = { (int)i, 0 };
+				bulletEntries.push_back(target);
+			}
+		}
+
+		// a little inside what is apart at the start, so generateContacts
+		// finds the contact; no deeper into what already overlaps
+		setBulletPose(pose, 0);
+		for (size_t i = 0; i < bulletEntries.size(); i++)
+			if (bulletOf[bulletEntries[i].index] >= 0)
+				setBulletPose(bulletPoses[bulletOf[bulletEntries[i].index]], 0);
+		for (size_t i = 0; i < bulletEntries.size(); i++)
+			bulletEntries[i].stop = real_fmin(entryGap(bullet, entries[bulletEntries[i].index]),
+				0) - BULLET_OVERLAP;
+		bulletPlanes.clear();
+		for (size_t p = 0; p < planes.size(); p++)
+		{
+			BulletTarget target = { (int)p,
+				real_fmin(entryGap(bullet, *planes[p]), 0) - BULLET_OVERLAP };
+			bulletPlanes.push_back(target);
+		}
+
+		// conservative advancement: no gap closes faster than the bounds
+		// of its two sides, so stepping by what is left of a gap over them
+		// never passes its stop; done once within half of BULLET_OVERLAP
+		// of one, or short of it when out of steps. A plane only bounds
+		// the motion along its normal.
+		real turn = pose.bound - pose.motion.magnitude();
+		real t = 0;
+		for (int k = 0; k < BULLET_ITERATIONS; k++)
+		{
+			real step = REAL_MAX;
+			real closest = REAL_MAX;
+			for (size_t i = 0; i < bulletEntries.size(); i++)
+			{
+				const BulletTarget &target = bulletEntries[i];
+				real bound = pose.bound;
+				if (bulletOf[target.index] >= 0)
+					bound += bulletPoses[bulletOf[target.index]].bound;
+				real left = entryGap(bullet, entries[target.index]) - target.stop;
+				closest = real_fmin(closest, left);
+				step = real_fmin(step, left / bound);
+			}
+			for (size_t p = 0; p < bulletPlanes.size(); p++)
+			{
+				const CollisionPlane &plane = *planes[bulletPlanes[p].index];
+				real bound = real_abs(pose.motion * plane.normal.unit()) + turn;
+				real left = entryGap(bullet, plane) - bulletPlanes[p].stop;
+				closest = real_fmin(closest, left);
+				if (bound > 0)
+					step = real_fmin(step, left / bound);
+			}
+			if (closest < BULLET_OVERLAP / 2)
+				break;
+
+			t += step;
+			if (t >= 1)
+				break;
+			setBulletPose(pose, t);
+			for (size_t i = 0; i < bulletEntries.size(); i++)
+				if (bulletOf[bulletEntries[i].index] >= 0)
+					setBulletPose(bulletPoses[bulletOf[bulletEntries[i].index]], t);
+		}
+
+		// the other bullets go back, this one keeps the pose it got to,
+		// which the later sweeps take as its end
+		for (size_t i = 0; i < bulletEntries.size(); i++)
+			if (bulletOf[bulletEntries[i].index] >= 0)
+				setBulletPose(bulletPoses[bulletOf[bulletEntries[i].index]], 1);
+		if (t >= 1)
+		{
+			setBulletPose(pose, 1);
+			continue;
+		}
+
+		// its box still holds what is left of the sweep
+		pose.endPosition = bullet.body->getPosition();
+		pose.endOrientation = bullet.body->getOrientation();
+		pose.endTransform = bullet.body->getTransformMatrix();
+		pose.motion = pose.motion * t;
+		pose.angle = pose.angle * t;
+		pose.bound = pose.bound * t;
+		swept++;
+	}
+	return swept;
+}
+
+int CollisionSpace::getPairCount() const
+{
+	return pairCount;
+}
\ No newline at end of file
@@ -3,20 +3,33 @@
 
 
 #include <assert.h>
+#include <vector>
 
 #include "precision.h"
 #include "core.h"
 #include "body.h"
 #include "contacts.h"
+#include "collide_coarse.h"
+
+enum CollisionPrimitiveType
+{
+	PRIMITIVE_SPHERE,
+	PRIMITIVE_BOX,
+	PRIMITIVE_POLYGON
+};
 
 class CollisionPrimitive
 {
 public:
 	RigidBody *body;
-	//Matrix3 offset;
+	CollisionPrimitiveType type;
+	Matrix3 offset; // primitive to body coordinates, identity unless in a compound
 
 public:
-	Vector2 CollisionPrimitive::getAxis(unsigned index) const;
+	Matrix3 getTransform() const; // primitive to world coordinates
+	Vector2 getPosition() const; // center in world coordinates
+	Vector2 getAxis(unsigned index) const; // of getTransform
+	BoundingBox getBoundingBox() const;
 };
 
 class CollisionSphere : public CollisionPrimitive
@@ -50,6 +63,50 @@ public:
 	CollisionBox(RigidBody *body, const Vector2& halfSize);
 };
 
+// Convex polygon, vertices counter-clockwise in body coordinates around
+// the center of mass; normals[i] is the outward normal of the edge from
+// vertex i to vertex i + 1
+class CollisionPolygon : public CollisionPrimitive
+{
+public:
+	static const int MAX_VERTICES = 8;
+
+	Vector2 vertices[MAX_VERTICES];
+	Vector2 normals[MAX_VERTICES];
+	int vertexCount;
+
+public:
+	CollisionPolygon();
+	CollisionPolygon(RigidBody *body, const Vector2 *vertices, int vertexCount);
+	// and the normals; false, leaving the polygon as it was, for fewer
+	// than 3 or more than MAX_VERTICES vertices or a zero-length edge
+	bool setVertices(const Vector2 *vertices, int vertexCount);
+};
+
+// Primitives fixed to one body at their offsets, so a rigid assembly
+// such as a chassis and its cabin needs neither more bodies nor joints.
+// A CollisionSpace gives it one broadphase entry and only tests the
+// children whose own bounding boxes overlap the other entry's shapes.
+class CollisionCompound
+{
+public:
+	// the child numbers take 4 bits of the contacts' feature ids
+	static const int MAX_CHILDREN = 16;
+
+	RigidBody *body;
+	std::vector<CollisionPrimitive*> children;
+
+public:
+	CollisionCompound();
+	CollisionCompound(RigidBody *body);
+	// sets the child's body and offset, position and orientation in body
+	// coordinates; add the children before the compound goes in a space.
+	// false, leaving the child out, once there are MAX_CHILDREN
+	bool add(CollisionPrimitive *child, const Vector2 &position,
+		const Vector2 &orientation = Vector2::X);
+	BoundingBox getBoundingBox() const;
+};
+
 
 struct CollisionData
 {
@@ -67,6 +124,20 @@ struct CollisionData
 	void addContacts(int n);
 };
 
+// Spheres in structure-of-arrays columns for the batch kernels; the
+// centers are read from the bodies when a sphere is added
+struct SphereColumns
+{
+	std::vector<const CollisionSphere*> sphere;
+	std::vector<real> x; // center
+	std::vector<real> y;
+	std::vector<real> radius;
+
+	void clear();
+	void add(const CollisionSphere *sphere);
+	int size() const;
+};
+
 class CollisionDetector
 {
 public:
@@ -82,11 +153,157 @@ public:
 		const CollisionSphere &sphere, CollisionData *data);
 	static int boxAndPoint(const CollisionBox &box,
 		const Vector2 &point, CollisionData *data);
+	// SAT on the four face axes, then the incident edge clipped to the
+	// reference face: at most two contacts. separatingAxis, if given, is
+	// the axis that separated the pair last time (-1 for none) and is
+	// tried first; it is updated for the next call.
 	static int boxAndBox(const CollisionBox &one,
-		const CollisionBox &two, CollisionData *data);
+		const CollisionBox &two, CollisionData *data, int *separatingAxis = NULL);
 
 	static unsigned boxAndBox2(const CollisionBox &one,
 		const CollisionBox &two, CollisionData *data);
+
+	// Batch forms of sphereAndSphere and sphereAndHalfSpace. The candidate
+	// pairs (first[i], second[i]), or every sphere against the plane, are
+	// tested on squared distance SIMD_LANES at a time (simd.h) and the
+	// overlapping ones compacted into survivors, which needs room for all
+	// candidates; only those reach a square root and a contact.
+	static int sphereAndSphereBatch(const SphereColumns &spheres,
+		const int *first, const int *second, int pairCount,
+		int *survivors, CollisionData *data);
+	static int sphereAndHalfSpaceBatch(const SphereColumns &spheres,
+		const CollisionPlane &plane, int *survivors, CollisionData *data);
+
+	// SAT on the edge normals, then the incident edge clipped to the
+	// reference edge as in boxAndBox: at most two contacts
+	static int polygonAndPolygon(const CollisionPolygon &one,
+		const CollisionPolygon &two, CollisionData *data);
+	static int polygonAndBox(const CollisionPolygon &polygon,
+		const CollisionBox &box, CollisionData *data);
+	static int polygonAndSphere(const CollisionPolygon &polygon,
+		const CollisionSphere &sphere, CollisionData *data);
+	static int polygonAndHalfSpace(const CollisionPolygon &polygon,
+		const CollisionPlane &plane, CollisionData *data);
+
+	// Lower bound on the distance between the primitives, or from the
+	// primitive to the half-space, negative when they overlap. Exact
+	// with a sphere; between boxes and polygons it is the largest
+	// separation on their edge normals.
+	static real primitiveGap(const CollisionPrimitive &one,
+		const CollisionPrimitive &two);
+	static real halfSpaceGap(const CollisionPrimitive &primitive,
+		const CollisionPlane &plane);
+
+	// dispatch on CollisionPrimitive::type
+	static int primitiveAndPrimitive(const CollisionPrimitive &one,
+		const CollisionPrimitive &two, CollisionData *data);
+	static int primitiveAndHalfSpace(const CollisionPrimitive &primitive,
+		const CollisionPlane &plane, CollisionData *data);
+};
+
+// Primitives and planes of a scene. Runs a broadphase over the
+// primitives' bounding boxes and the narrow phase on the candidate pairs
+// only, instead of testing every pair.
+class CollisionSpace
+{
+protected:
+	// a primitive or a compound, its shapes are
+	// shapes[firstShape, firstShape + shapeCount)
+	struct Entry
+	{
+		RigidBody *body;
+		int firstShape;
+		int shapeCount;
+		unsigned category; // bits this entry is in
+		unsigned mask; // categories it collides with
+	};
+
+	std::vector<Entry> entries;
+	std::vector<CollisionPrimitive*> shapes;
+	std::vector<CollisionPlane*> planes;
+	std::vector<BoundingBox> boxes; // per entry, for the broadphase
+	std::vector<BoundingBox> shapeBoxes; // per shape, for the mid-phase
+	std::vector<PotentialPair> pairs;
+	int pairCount;
+
+	// sphere-sphere pairs and sphere-plane tests go to the batch kernels
+	SphereColumns spheres;
+	std::vector<int> sphereOf; // column of each shape, -1 if not a sphere
+	std::vector<int> sphereFirst; // candidate sphere pairs, as columns
+	std::vector<int> sphereSecond;
+	std::vector<int> survivors;
+
+	// separating axes of the box pairs, keyed by their shapes; a pair
+	// not tested in a generateContacts is dropped at the next one
+	HashTable lastAxes;
+	HashTable nextAxes;
+
+	SpatialHash spatialHash;
+	Broadphase *broadphase;
+
+	// an awake bullet's motion over the step, from where it was before
+	// to where it is after, or where its sweep stopped it
+	struct BulletPose
+	{
+		int entry;
+		Vector2 position;
+		Vector2 orientation;
+		Vector2 endPosition;
+		Vector2 endOrientation;
+		Matrix3 endTransform;
+		Vector2 motion;
+		real angle;
+		real bound; // no point of the bullet moves further
+	};
+	std::vector<BulletPose> bulletPoses;
+	std::vector<int> bulletOf; // pose of each entry, -1 if not a bullet
+
+	// an entry or plane one bullet is swept against, and the gap the
+	// sweep stops at
+	struct BulletTarget
+	{
+		int index;
+		real stop;
+	};
+	std::vector<BulletTarget> bulletEntries;
+	std::vector<BulletTarget> bulletPlanes;
+
+protected:
+	// narrow phase of two shapes, or their place in a batch
+	void generateShapeContacts(int one, int other, CollisionData *data);
+	// smallest gap between their shapes, see primitiveGap
+	real entryGap(const Entry &one, const Entry &two) const;
+	real entryGap(const Entry &entry, const CollisionPlane &plane) const;
+	// puts a bullet a fraction t along its motion, at its end pose for 1
+	void setBulletPose(const BulletPose &pose, real t);
+
+public:
+	CollisionSpace();
+
+	void add(CollisionPrimitive *primitive,
+		unsigned category = 1, unsigned mask = ~0u);
+	void add(CollisionCompound *compound,
+		unsigned category = 1, unsigned mask = ~0u);
+	void addPlane(CollisionPlane *plane);
+	void clear();
+	// NULL restores the default spatial hash
+	void setBroadphase(Broadphase *broadphase);
+
+	int generateContacts(CollisionData *data);
+	int getPairCount() const; // candidate pairs of the last generateContacts
+
+	// Continuous collision for bodies flagged with RigidBody::setBullet,
+	// meant for a few fast ones. storeBulletPoses keeps the poses of the
+	// awake bullets before the world integrates; sweepBullets, after it,
+	// moves each bullet back along its motion to just inside the first
+	// entry or plane in the way (conservative advancement), so the next
+	// generateContacts sees the contact instead of the bullet passing
+	// through. It goes no deeper into what it already overlaps. Other
+	// bullets move along with the one swept, the rest of the bodies stay
+	// at their end pose. The rest of the motion is dropped, the velocity
+	// kept. Returns the bullets moved back.
+	void storeBulletPoses();
+	int sweepBullets();
 };
 
 
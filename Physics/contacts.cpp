@@ -1,3 +1,5 @@
+#include <utility>
+
 #include "contacts.h"
 
 void Contact::setBodyData(RigidBody* body1, RigidBody* body2,
@@ -7,6 +9,7 @@ void Contact::setBodyData(RigidBody* body1, RigidBody* body2,
 	this->body[1] = body2;
 	this->friction = friction;
 	this->restitution = restitution;
+	this->feature = 0;
 }
 
 void Contact::calculateInternals(real duration)
@@ -136,21 +139,22 @@ void Contact::applyVelocityChange()
 	if (contactVelocity.x >= 0)
 		return;
 
+	// immovable bodies are left untouched, islands resolved on other
+	// threads may share them
 	Vector2 impulse = contactToWorld * calculateFrictionImpulse();
-	body[0]->applyImpulseAtPoint(impulse, contactPoint);
-
-	velocityChange[0] = impulse *  body[0]->getInverseMass();
-	rotationChange[0] = -(impulse.crossProduct(contactPoint - body[0]->getPosition()))
-		* body[0]->getInverseMomentOfInertia();
-
-	if (body[1] != NULL)
+	for (int i = 0; i < 2; i++)
 	{
-		impulse.invert();
-		body[1]->applyImpulseAtPoint(impulse, contactPoint);
+		velocityChange[i] = Vector2();
+		rotationChange[i] = 0;
+		if (body[i] == NULL || !body[i]->isMovable())
+			continue;
 
-		velocityChange[1] = impulse *  body[1]->getInverseMass();
-		rotationChange[1] = -(impulse.crossProduct(contactPoint - body[1]->getPosition()))
-			* body[1]->getInverseMomentOfInertia();
+		Vector2 bodyImpulse = (i == 0) ? impulse : -impulse;
+		body[i]->applyImpulseAtPoint(bodyImpulse, contactPoint);
+
+		velocityChange[i] = bodyImpulse *  body[i]->getInverseMass();
+		rotationChange[i] = -(bodyImpulse.crossProduct(contactPoint - body[i]->getPosition()))
+			* body[i]->getInverseMomentOfInertia();
 	}
 }
 
@@ -202,15 +206,46 @@ void Contact::applyPositionChange()
 			else
 				angularChange[i] = deltaAngularVelocity[i] / angularInertia[i] * angularMove[i];
 
+			if (!body[i]->isMovable())
+				continue;
 			body[i]->move(linearChange[i]);
 			body[i]->rotate(angularChange[i]);
 			body[i]->calculateDerivedData();
 		}
 }
 
+void Contact::applyImpulse(const Vector2 &impulse)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (inverseMass[i] == 0 && inverseMomentOfInertia[i] == 0)
+			continue;
+
+		Vector2 bodyImpulse = (i == 0) ? impulse : -impulse;
+		body[i]->applyImpulseAtPoint(bodyImpulse, contactPoint);
+	}
+}
+
+Vector2 Contact::calculateRelativeVelocity() const
+{
+	Vector2 velocity = body[0]->getVelocity() +
+		relativeContactPosition[0].crossProduct(-body[0]->getAngularVelocity());
+	if (body[1] != NULL)
+		velocity = velocity - (body[1]->getVelocity() +
+			relativeContactPosition[1].crossProduct(-body[1]->getAngularVelocity()));
+	return velocity;
+}
+
 ContactResolver::ContactResolver(int velocityIteration, int positionIteration,
 	real velocityEpsilon, real positionEpsilon)
 {
+	this->mode = RESOLVE_WORST_FIRST;
+	this->useIslands = false;
+	this->jobs = NULL;
+	this->workspaces.resize(1);
+	this->taskDuration = 0;
+	this->positionCorrection = (real)0.4;
+	this->penetrationSlop = (real)0.001;
 	this->positionIteration = positionIteration;
 	this->velocityIteration = velocityIteration;
 	this->positionEpsilon = positionEpsilon;
@@ -223,14 +258,205 @@ void ContactResolver::setIterations(int velocityIteration, int positionIteration
 	ContactResolver::positionIteration = positionIteration;
 }
 
+void ContactResolver::setMode(ResolverMode mode)
+{
+	ContactResolver::mode = mode;
+}
+
+ResolverMode ContactResolver::getMode() const
+{
+	return mode;
+}
+
+void ContactResolver::setPositionCorrection(real positionCorrection, real penetrationSlop)
+{
+	ContactResolver::positionCorrection = positionCorrection;
+	ContactResolver::penetrationSlop = penetrationSlop;
+}
+
+ContactCache& ContactResolver::getCache()
+{
+	return cache;
+}
+
+void ContactResolver::setIslands(bool islands)
+{
+	useIslands = islands;
+}
+
+IslandGraph& ContactResolver::getIslands()
+{
+	return islands;
+}
+
+void ContactResolver::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+	workspaces.resize(jobs != NULL ? jobs->getThreadCount() : 1);
+}
+
 void ContactResolver::resolveContacts(Contact *contactArray,
 	int numContacts, real duration)
 {
 	if (numContacts == 0)
 		return;
-	prepareContacts(contactArray, numContacts, duration);
-	adjustPositions(contactArray, numContacts, duration);
-	adjustVelocities(contactArray, numContacts, duration);
+
+	// the cache is only touched here, never from the island jobs
+	if (mode == RESOLVE_SEQUENTIAL_IMPULSE)
+	{
+		cache.nextFrame();
+		fetchImpulses(contactArray, numContacts);
+	}
+
+	if (!useIslands)
+	{
+		Workspace& work = workspaces[0];
+		resolveGroup(work, contactArray, numContacts, duration,
+			positionIteration, velocityIteration);
+		positionIterationUsed = work.positionIterationUsed;
+		velocityIterationUsed = work.velocityIterationUsed;
+		if (mode == RESOLVE_SEQUENTIAL_IMPULSE)
+			storeImpulses(contactArray, numContacts);
+		PROFILE_CONTACTS(numContacts);
+		PROFILE_ITERATIONS(positionIterationUsed, velocityIterationUsed);
+		return;
+	}
+
+	islands.clear();
+	islands.addContacts(contactArray, numContacts);
+	int islandNum = islands.build();
+
+	// group the contacts by island; a contact between two immovable
+	// bodies is in none and is left alone
+	islandStart.assign(islandNum + 1, 0);
+	contactIsland.resize(numContacts);
+	for (int i = 0; i < numContacts; i++)
+	{
+		contactIsland[i] = islands.getContactIsland(contactArray[i]);
+		if (contactIsland[i] >= 0)
+			islandStart[contactIsland[i] + 1]++;
+	}
+	for (int i = 0; i < islandNum; i++)
+		islandStart[i + 1] += islandStart[i];
+
+	islandOrder.resize(islandStart[islandNum]);
+	islandContacts.resize(islandStart[islandNum]);
+	islandFill.assign(islandStart.begin(), islandStart.end() - 1);
+	for (int i = 0; i < numContacts; i++)
+	{
+		if (contactIsland[i] < 0)
+			continue;
+		int k = islandFill[contactIsland[i]]++;
+		islandOrder[k] = i;
+		islandContacts[k] = contactArray[i];
+	}
+
+	// sleeping islands cost nothing; in worst-first mode each island gets
+	// the iteration budget in proportion to its contacts
+	tasks.clear();
+	for (int i = 0; i < islandNum; i++)
+	{
+		IslandTask task;
+		task.start = islandStart[i];
+		task.count = islandStart[i + 1] - task.start;
+		if (task.count == 0 || !islands.isIslandAwake(i))
+			continue;
+
+		task.positionIteration = positionIteration;
+		task.velocityIteration = velocityIteration;
+		if (mode == RESOLVE_WORST_FIRST)
+		{
+			task.positionIteration = (int)(((long long)positionIteration * task.count +
+				numContacts - 1) / numContacts);
+			task.velocityIteration = (int)(((long long)velocityIteration * task.count +
+				numContacts - 1) / numContacts);
+		}
+		tasks.push_back(task);
+	}
+
+	// islands share no movable body, so they can be resolved in any
+	// order and on any thread with the same result. Islands large enough
+	// to be coloured spread their batches over the threads themselves and
+	// are resolved one by one on this thread afterwards.
+	int islandJobs = 0;
+	for (size_t t = 0; t < tasks.size(); t++)
+		if (mode != RESOLVE_SEQUENTIAL_IMPULSE || tasks[t].count < BATCH_MIN_CONTACTS)
+			std::swap(tasks[islandJobs++], tasks[t]);
+
+	taskDuration = duration;
+	if (jobs != NULL)
+		jobs->parallelFor(islandJobs, resolveTask, this);
+	else
+		for (int t = 0; t < islandJobs; t++)
+			resolveTask(this, t);
+	for (size_t t = islandJobs; t < tasks.size(); t++)
+		resolveTask(this, (int)t);
+
+	int resolved = 0;
+	positionIterationUsed = 0;
+	velocityIterationUsed = 0;
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		if (mode == RESOLVE_SEQUENTIAL_IMPULSE)
+			storeImpulses(&islandContacts[tasks[t].start], tasks[t].count);
+		resolved += tasks[t].count;
+		positionIterationUsed += tasks[t].positionIterationUsed;
+		velocityIterationUsed += tasks[t].velocityIterationUsed;
+	}
+	PROFILE_CONTACTS(resolved);
+	PROFILE_ITERATIONS(positionIterationUsed, velocityIterationUsed);
+
+	for (size_t k = 0; k < islandOrder.size(); k++)
+		contactArray[islandOrder[k]] = islandContacts[k];
+}
+
+void ContactResolver::resolveTask(void *data, int index)
+{
+	ContactResolver *resolver = (ContactResolver*)data;
+	IslandTask& task = resolver->tasks[index];
+	Workspace& work = resolver->workspaces[JobSystem::getThreadIndex()];
+
+	resolver->resolveGroup(work, &resolver->islandContacts[task.start], task.count,
+		resolver->taskDuration, task.positionIteration, task.velocityIteration);
+	task.positionIterationUsed = work.positionIterationUsed;
+	task.velocityIterationUsed = work.velocityIterationUsed;
+}
+
+void ContactResolver::resolveGroup(Workspace &work, Contact *contactArray,
+	int numContacts, real duration, int positionIteration, int velocityIteration)
+{
+	if (mode == RESOLVE_SEQUENTIAL_IMPULSE)
+	{
+		{
+			PROFILE_SCOPE(PROFILE_PREPARE_CONTACTS);
+			prepareContacts(work, contactArray, numContacts, duration);
+			prepareImpulses(contactArray, numContacts);
+			colourContacts(work, contactArray, numContacts);
+			warmStart(contactArray, numContacts);
+		}
+		{
+			PROFILE_SCOPE(PROFILE_ADJUST_VELOCITIES);
+			solveVelocities(work, contactArray, numContacts, velocityIteration);
+		}
+		{
+			PROFILE_SCOPE(PROFILE_ADJUST_POSITIONS);
+			solvePositions(work, contactArray, numContacts, positionIteration);
+		}
+		return;
+	}
+
+	{
+		PROFILE_SCOPE(PROFILE_PREPARE_CONTACTS);
+		prepareContacts(work, contactArray, numContacts, duration);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_ADJUST_POSITIONS);
+		adjustPositions(work, contactArray, numContacts, duration, positionIteration);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_ADJUST_VELOCITIES);
+		adjustVelocities(work, contactArray, numContacts, duration, velocityIteration);
+	}
 	
 	/*for (int i = 0; i < numContacts; i++)
 	{
@@ -240,145 +466,662 @@ void ContactResolver::resolveContacts(Contact *contactArray,
 	}*/
 }
 
-void ContactResolver::prepareContacts(Contact *contactArray,
+void ContactResolver::prepareContacts(Workspace &work, Contact *contactArray,
 	int numContacts, real duration)
 {
 	for (int i = 0; i < numContacts; i++)
 		contactArray[i].calculateInternals(duration);
+
+	buildBodyContacts(work, contactArray, numContacts);
 }
 
-void ContactResolver::adjustPositions(Contact *contactArray,
-	int numContacts, real duration)
+void ContactResolver::buildBodyContacts(Workspace &work, Contact *contactArray, int numContacts)
 {
-	Vector2 linearChange[2];
-	real angularChange[2];
+	work.bodyTable.clear();
+	work.bodyContactStart.clear();
+	work.slotBodies.clear();
+	work.contactBodySlot.resize(2 * numContacts);
 
-	positionIterationUsed = 0;
-	while (positionIterationUsed < positionIteration)
+	// count the contacts of each body
+	for (int i = 0; i < numContacts; i++)
 	{
-		real max = positionEpsilon;
-		int indexMax = -1;
-
-		for (int i = 0; i < numContacts; i++)
+		for (int b = 0; b < 2; b++)
 		{
-			if (contactArray[i].penetration > max)
+			int slot = -1;
+			if (contactArray[i].body[b] != NULL)
 			{
-				max = contactArray[i].penetration;
-				indexMax = i;
+				HashTable::Key key = (HashTable::Key)(size_t)contactArray[i].body[b];
+				slot = work.bodyTable.find(key);
+				if (slot < 0)
+				{
+					slot = (int)work.bodyContactStart.size();
+					work.bodyTable.insert(key, slot);
+					work.bodyContactStart.push_back(0);
+					work.slotBodies.push_back(contactArray[i].body[b]);
+				}
+				work.bodyContactStart[slot]++;
 			}
+			work.contactBodySlot[2 * i + b] = slot;
 		}
-		if (indexMax == -1)
+	}
+
+	// counts to offsets, then fill; filling advances each offset to the
+	// next slot's, shifting back restores them
+	int bodyNum = (int)work.bodyContactStart.size();
+	int total = 0;
+	for (int slot = 0; slot < bodyNum; slot++)
+	{
+		int count = work.bodyContactStart[slot];
+		work.bodyContactStart[slot] = total;
+		total += count;
+	}
+	work.bodyContactStart.push_back(total);
+	work.bodyContacts.resize(total);
+
+	for (int i = 0; i < numContacts; i++)
+		for (int b = 0; b < 2; b++)
+			if (work.contactBodySlot[2 * i + b] >= 0)
+				work.bodyContacts[work.bodyContactStart[work.contactBodySlot[2 * i + b]]++] = i;
+
+	for (int slot = bodyNum; slot > 0; slot--)
+		work.bodyContactStart[slot] = work.bodyContactStart[slot - 1];
+	work.bodyContactStart[0] = 0;
+}
+
+void ContactResolver::adjustPositions(Workspace &work, Contact *contactArray,
+	int numContacts, real duration, int positionIteration)
+{
+	Vector2 linearChange[2];
+	real angularChange[2];
+
+	work.heap.reset(numContacts);
+	for (int i = 0; i < numContacts; i++)
+		work.heap.set(i, contactArray[i].penetration);
+	work.heap.build();
+	work.touched.assign(numContacts, -1);
+
+	work.positionIterationUsed = 0;
+	while (work.positionIterationUsed < positionIteration)
+	{
+		int indexMax = work.heap.top();
+		if (indexMax == -1 || work.heap.getKey(indexMax) <= positionEpsilon)
 			break;
 
-		contactArray[indexMax].applyPositionChange();
-		contactArray[indexMax].calculateInternals(duration);
+		Contact& resolved = contactArray[indexMax];
+		resolved.applyPositionChange();
+		resolved.calculateInternals(duration);
 
 		// resolve penetration
-		linearChange[0] = contactArray[indexMax].linearChange[0];
-		linearChange[1] = contactArray[indexMax].linearChange[1];
-		angularChange[0] = contactArray[indexMax].angularChange[0];
-		angularChange[1] = contactArray[indexMax].angularChange[1];
+		linearChange[0] = resolved.linearChange[0];
+		linearChange[1] = resolved.linearChange[1];
+		angularChange[0] = resolved.angularChange[0];
+		angularChange[1] = resolved.angularChange[1];
 
-		for (int i = 0; i < numContacts; i++)
+		work.updated.clear();
+		for (int d = 0; d < 2; d++)
 		{
-			for (int b = 0; b < 2; b++)
+			int slot = work.contactBodySlot[2 * indexMax + d];
+			if (slot < 0)
+				continue;
+
+			for (int k = work.bodyContactStart[slot]; k < work.bodyContactStart[slot + 1]; k++)
 			{
-				if (contactArray[i].body[b] != NULL)
+				int i = work.bodyContacts[k];
+				Contact& contact = contactArray[i];
+				for (int b = 0; b < 2; b++)
+				{
+					if (contact.body[b] != resolved.body[d])
+						continue;
+
+					Vector2 deltaPosition = linearChange[d] +
+						contact.relativeContactPosition[b].crossProduct(-angularChange[d]);
+
+					int sign;
+					if (b == 0)
+						sign = -1;
+					else
+						sign = 1;
+
+					contact.penetration += deltaPosition * (contact.contactNormal) * sign;
+				}
+
+				if (work.touched[i] != work.positionIterationUsed)
 				{
-					for (int d = 0; d < 2; d++)
-					{
-						if (contactArray[i].body[b] == contactArray[indexMax].body[d])
-						{
-							Vector2 deltaPosition = linearChange[d] + 
-								contactArray[i].relativeContactPosition[b].crossProduct(
-								-angularChange[d]);
-
-							int sign;
-							if (b == 0)
-								sign = -1;
-							else
-								sign = 1;
-
-							contactArray[i].penetration +=
-								deltaPosition * (contactArray[i].contactNormal) * sign;
-
-							contactArray[i].calculateInternals(duration);
-						}
-					}
+					work.touched[i] = work.positionIterationUsed;
+					work.updated.push_back(i);
 				}
 			}
 		}
-		positionIterationUsed++;
+
+		for (size_t k = 0; k < work.updated.size(); k++)
+		{
+			int i = work.updated[k];
+			contactArray[i].calculateInternals(duration);
+			work.heap.update(i, contactArray[i].penetration);
+		}
+		work.positionIterationUsed++;
 	}
 }
 
-void ContactResolver::adjustVelocities(Contact *contactArray,
-	int numContacts, real duration)
+void ContactResolver::adjustVelocities(Workspace &work, Contact *contactArray,
+	int numContacts, real duration, int velocityIteration)
 {
 	Vector2 velocityChange[2];
 	real rotationChange[2];
 
-	velocityIterationUsed = 0;
-	while (velocityIterationUsed < velocityIteration)
+	work.heap.reset(numContacts);
+	for (int i = 0; i < numContacts; i++)
+		work.heap.set(i, contactArray[i].desiredDeltaVelocity);
+	work.heap.build();
+	work.touched.assign(numContacts, -1);
+
+	work.velocityIterationUsed = 0;
+	while (work.velocityIterationUsed < velocityIteration)
 	{
-		real max = velocityEpsilon;
-		int indexMax = -1;
+		int indexMax = work.heap.top();
+		if (indexMax == -1 || work.heap.getKey(indexMax) <= velocityEpsilon)
+			break;
+
+		Contact& resolved = contactArray[indexMax];
+		resolved.matchAwakeState();
+		resolved.applyVelocityChange();
+		resolved.calculateInternals(duration);
 
-		for (int i = 0; i < numContacts; i++)
+		// resolve penetration
+		velocityChange[0] = resolved.velocityChange[0];
+		velocityChange[1] = resolved.velocityChange[1];
+		rotationChange[0] = resolved.rotationChange[0];
+		rotationChange[1] = resolved.rotationChange[1];
+
+		work.updated.clear();
+		for (int d = 0; d < 2; d++)
 		{
-			if (contactArray[i].desiredDeltaVelocity > max)
+			int slot = work.contactBodySlot[2 * indexMax + d];
+			if (slot < 0)
+				continue;
+
+			for (int k = work.bodyContactStart[slot]; k < work.bodyContactStart[slot + 1]; k++)
 			{
-				max = contactArray[i].desiredDeltaVelocity;
-				indexMax = i;
+				int i = work.bodyContacts[k];
+				Contact& contact = contactArray[i];
+				for (int b = 0; b < 2; b++)
+				{
+					if (contact.body[b] != resolved.body[d])
+						continue;
+
+					Vector2 deltaVelocity = velocityChange[d] +
+						contact.relativeContactPosition[b].crossProduct(-rotationChange[d]);
+
+					int sign;
+					if (b == 0)
+						sign = 1;
+					else
+						sign = -1;
+
+					contact.contactVelocity.add(
+						contact.contactToWorld.transpose() * deltaVelocity * sign);
+				}
+
+				if (work.touched[i] != work.velocityIterationUsed)
+				{
+					work.touched[i] = work.velocityIterationUsed;
+					work.updated.push_back(i);
+				}
 			}
 		}
-		if (indexMax == -1)
-			break;
-		
-		contactArray[indexMax].matchAwakeState();
-		contactArray[indexMax].applyVelocityChange();
-		contactArray[indexMax].calculateInternals(duration);
 
-		// resolve penetration
-		velocityChange[0] = contactArray[indexMax].velocityChange[0];
-		velocityChange[1] = contactArray[indexMax].velocityChange[1];
-		rotationChange[0] = contactArray[indexMax].rotationChange[0];
-		rotationChange[1] = contactArray[indexMax].rotationChange[1];
+		for (size_t k = 0; k < work.updated.size(); k++)
+		{
+			int i = work.updated[k];
+			contactArray[i].calculateInternals(duration);
+			work.heap.update(i, contactArray[i].desiredDeltaVelocity);
+		}
+		work.velocityIterationUsed++;
+	}
+}
 
-		for (int i = 0; i < numContacts; i++)
+void ContactResolver::prepareImpulses(Contact *contactArray, int numContacts)
+{
+	for (int i = 0; i < numContacts; i++)
+	{
+		// a body touching an awake one is solved awake; bodies asleep
+		// on both sides stay put, like immovable ones
+		Contact& contact = contactArray[i];
+		contact.matchAwakeState();
+
+		for (int b = 0; b < 2; b++)
+		{
+			RigidBody* body = contact.body[b];
+			bool movable = (body != NULL && body->getIsAwake());
+			contact.inverseMass[b] = movable ? body->getInverseMass() : 0;
+			contact.inverseMomentOfInertia[b] = movable ? body->getInverseMomentOfInertia() : 0;
+		}
+
+		Vector2 normal = contact.contactNormal;
+		Vector2 tangent = normal.crossProduct(-1);
+		real normalInverse = 0;
+		real tangentInverse = 0;
+		for (int b = 0; b < 2; b++)
+		{
+			real rn = contact.relativeContactPosition[b].crossProduct(normal);
+			real rt = contact.relativeContactPosition[b].crossProduct(tangent);
+			normalInverse += contact.inverseMass[b] + contact.inverseMomentOfInertia[b] * rn * rn;
+			tangentInverse += contact.inverseMass[b] + contact.inverseMomentOfInertia[b] * rt * rt;
+		}
+		contact.normalMass = (normalInverse > 0) ? 1 / normalInverse : 0;
+		contact.tangentMass = (tangentInverse > 0) ? 1 / tangentInverse : 0;
+
+		// desiredDeltaVelocity already holds the bounce minus the velocity
+		// built up by this step's acceleration
+		contact.velocityBias = real_fmax(contact.desiredDeltaVelocity + contact.contactVelocity.x, 0);
+
+		contact.positionImpulse = 0;
+	}
+}
+
+void ContactResolver::warmStart(Contact *contactArray, int numContacts)
+{
+	// the impulses were fetched from the cache by resolveContacts
+	for (int i = 0; i < numContacts; i++)
+	{
+		Contact& contact = contactArray[i];
+		if (contact.normalMass == 0)
+			continue;
+
+		Vector2 tangent = contact.contactNormal.crossProduct(-1);
+		contact.applyImpulse(contact.contactNormal * contact.normalImpulse +
+			tangent * contact.tangentImpulse);
+	}
+}
+
+void ContactResolver::colourContacts(Workspace &work, Contact *contactArray, int numContacts)
+{
+	work.batchStart.clear();
+	if (numContacts < BATCH_MIN_CONTACTS)
+		return;
+
+	// greedy colouring in contact order, the lowest colour free on both
+	// bodies; immovable bodies are never written and constrain nothing.
+	// The result only depends on the contact order, so does the solve.
+	int bodyNum = (int)work.slotBodies.size();
+	work.slotColours.assign(bodyNum, 0);
+	work.batchStart.assign(MAX_COLOURS + 2, 0);
+	std::vector<int> &colour = work.contactColour;
+	colour.assign(numContacts, -1);
+	for (int i = 0; i < numContacts; i++)
+	{
+		if (contactArray[i].normalMass == 0)
+			continue;
+
+		unsigned long long used = 0;
+		for (int b = 0; b < 2; b++)
 		{
+			int slot = work.contactBodySlot[2 * i + b];
+			if (slot >= 0 && work.slotBodies[slot]->isMovable())
+				used |= work.slotColours[slot];
+		}
+
+		int c = 0;
+		while (c < MAX_COLOURS && (used & (1ULL << c)))
+			c++;
+		colour[i] = c; // MAX_COLOURS is the serial batch
+
+		if (c < MAX_COLOURS)
 			for (int b = 0; b < 2; b++)
 			{
-				if (contactArray[i].body[b] != NULL)
-				{
-					for (int d = 0; d < 2; d++)
-					{
-						if (contactArray[i].body[b] == contactArray[indexMax].body[d])
-						{
-							Vector2 deltaVelocity = velocityChange[d] +
-								contactArray[i].relativeContactPosition[b].crossProduct(
-								-rotationChange[d]);
-
-							int sign;
-							if (b == 0)
-								sign = 1;
-							else
-								sign = -1;
-
-							contactArray[i].contactVelocity.add(
-								contactArray[i].contactToWorld.transpose() * deltaVelocity * sign);
-
-							//contactArray[i].calculateDesiredDeltaVelocity(duration);
-							contactArray[i].calculateInternals(duration);
-						}
-					}
-				}
+				int slot = work.contactBodySlot[2 * i + b];
+				if (slot >= 0 && work.slotBodies[slot]->isMovable())
+					work.slotColours[slot] |= 1ULL << c;
+			}
+		work.batchStart[c + 1]++;
+	}
+
+	for (int c = 0; c <= MAX_COLOURS; c++)
+		work.batchStart[c + 1] += work.batchStart[c];
+	work.batchContacts.resize(work.batchStart[MAX_COLOURS + 1]);
+	work.batchFill.assign(work.batchStart.begin(), work.batchStart.end() - 1);
+	for (int i = 0; i < numContacts; i++)
+		if (colour[i] >= 0)
+			work.batchContacts[work.batchFill[colour[i]]++] = i;
+}
+
+void ContactResolver::solveVelocities(Workspace &work, Contact *contactArray,
+	int numContacts, int velocityIteration)
+{
+	work.velocityIterationUsed = 0;
+	while (work.velocityIterationUsed < velocityIteration)
+	{
+		if (work.batchStart.empty())
+		{
+			for (int i = 0; i < numContacts; i++)
+				if (contactArray[i].normalMass != 0)
+					solveVelocity(contactArray[i]);
+		}
+		else
+			solveBatches(work, contactArray, false);
+		work.velocityIterationUsed++;
+	}
+}
+
+void ContactResolver::solveVelocity(Contact &contact)
+{
+	Vector2 normal = contact.contactNormal;
+	Vector2 tangent = normal.crossProduct(-1);
+
+	// friction, bounded by the normal impulse so far
+	Vector2 velocity = contact.calculateRelativeVelocity();
+	real lambda = -(velocity * tangent) * contact.tangentMass;
+	real maxFriction = contact.friction * contact.normalImpulse;
+	real old = contact.tangentImpulse;
+	contact.tangentImpulse = real_fmax(-maxFriction,
+		real_fmin(old + lambda, maxFriction));
+	contact.applyImpulse(tangent * (contact.tangentImpulse - old));
+
+	// normal, the accumulated impulse may only push
+	velocity = contact.calculateRelativeVelocity();
+	lambda = (contact.velocityBias - velocity * normal) * contact.normalMass;
+	old = contact.normalImpulse;
+	contact.normalImpulse = real_fmax(old + lambda, 0);
+	contact.applyImpulse(normal * (contact.normalImpulse - old));
+}
+
+void ContactResolver::solvePositions(Workspace &work, Contact *contactArray,
+	int numContacts, int positionIteration)
+{
+	// split impulses: solved for displacements directly, so the
+	// correction never shows up as velocity
+	int bodyNum = (int)work.slotBodies.size();
+	work.displacement.assign(bodyNum, Vector2());
+	work.rotation.assign(bodyNum, 0);
+
+	work.positionIterationUsed = 0;
+	while (work.positionIterationUsed < positionIteration)
+	{
+		if (work.batchStart.empty())
+		{
+			for (int i = 0; i < numContacts; i++)
+				if (contactArray[i].normalMass != 0)
+					solvePosition(work, contactArray, i);
+		}
+		else
+			solveBatches(work, contactArray, true);
+		work.positionIterationUsed++;
+	}
+
+	for (int slot = 0; slot < bodyNum; slot++)
+	{
+		if (work.displacement[slot].squareMagnitude() == 0 && work.rotation[slot] == 0)
+			continue;
+		work.slotBodies[slot]->move(work.displacement[slot]);
+		work.slotBodies[slot]->rotate(work.rotation[slot]);
+		work.slotBodies[slot]->calculateDerivedData();
+	}
+}
+
+void ContactResolver::solvePosition(Workspace &work, Contact *contactArray, int index)
+{
+	Contact& contact = contactArray[index];
+	Vector2 normal = contact.contactNormal;
+	real moved = 0;
+	for (int b = 0; b < 2; b++)
+	{
+		int slot = work.contactBodySlot[2 * index + b];
+		if (slot < 0)
+			continue;
+		Vector2 pointMove = work.displacement[slot] +
+			contact.relativeContactPosition[b].crossProduct(-work.rotation[slot]);
+		moved += (b == 0) ? pointMove * normal : -(pointMove * normal);
+	}
+
+	real target = positionCorrection *
+		real_fmax(contact.penetration - penetrationSlop, 0);
+	real lambda = (target - moved) * contact.normalMass;
+	real old = contact.positionImpulse;
+	contact.positionImpulse = real_fmax(old + lambda, 0);
+	lambda = contact.positionImpulse - old;
+
+	for (int b = 0; b < 2; b++)
+	{
+		int slot = work.contactBodySlot[2 * index + b];
+		// slots of immovable bodies stay zero, batches may share them
+		if (slot < 0 || (contact.inverseMass[b] == 0 && contact.inverseMomentOfInertia[b] == 0))
+			continue;
+		real sign = (b == 0) ? lambda : -lambda;
+		work.displacement[slot].add(normal * (sign * contact.inverseMass[b]));
+		work.rotation[slot] += contact.relativeContactPosition[b].crossProduct(normal) *
+			sign * contact.inverseMomentOfInertia[b];
+	}
+}
+
+void ContactResolver::solveBatches(Workspace &work, Contact *contactArray, bool positions)
+{
+	// colours in ascending order, the serial batch last; contacts of one
+	// colour are independent, so the chunks may run in any order
+	for (int c = 0; c <= MAX_COLOURS; c++)
+	{
+		BatchPass pass;
+		pass.resolver = this;
+		pass.work = &work;
+		pass.contactArray = contactArray;
+		pass.contacts = work.batchContacts.data() + work.batchStart[c];
+		pass.count = work.batchStart[c + 1] - work.batchStart[c];
+		pass.positions = positions;
+		if (pass.count == 0)
+			continue;
+
+		int chunks = (pass.count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+		if (jobs == NULL || c == MAX_COLOURS || chunks == 1)
+		{
+			for (int k = 0; k < pass.count; k++)
+			{
+				if (positions)
+					solvePosition(work, contactArray, pass.contacts[k]);
+				else
+					solveVelocity(contactArray[pass.contacts[k]]);
 			}
 		}
-		velocityIterationUsed++;
+		else
+			jobs->parallelFor(chunks, solveBatchChunk, &pass);
 	}
 }
 
+void ContactResolver::solveBatchChunk(void *data, int chunk)
+{
+	BatchPass *pass = (BatchPass*)data;
+	int begin = chunk * BATCH_CHUNK;
+	int end = begin + BATCH_CHUNK;
+	if (end > pass->count)
+		end = pass->count;
+
+	for (int k = begin; k < end; k++)
+	{
+		if (pass->positions)
+			pass->resolver->solvePosition(*pass->work, pass->contactArray, pass->contacts[k]);
+		else
+			pass->resolver->solveVelocity(pass->contactArray[pass->contacts[k]]);
+	}
+}
+
+void ContactResolver::fetchImpulses(Contact *contactArray, int numContacts)
+{
+	for (int i = 0; i < numContacts; i++)
+	{
+		Contact& contact = contactArray[i];
+		if (!cache.fetch(&contact))
+		{
+			contact.normalImpulse = 0;
+			contact.tangentImpulse = 0;
+		}
+	}
+}
+
+void ContactResolver::storeImpulses(Contact *contactArray, int numContacts)
+{
+	for (int i = 0; i < numContacts; i++)
+		if (contactArray[i].normalMass != 0)
+			cache.store(contactArray[i]);
+}
+
+ContactCache::ContactCache(int capacity, unsigned maxAge)
+{
+	int size = 8;
+	while (size < capacity * 2)
+		size <<= 1;
+
+	Entry empty = { { NULL, NULL }, 0, 0, 0, 0 };
+	slots.assign(size, empty);
+	occupied = 0;
+	frame = 1;
+	this->maxAge = maxAge;
+	hits = 0;
+}
+
+int ContactCache::slotOf(RigidBody* one, RigidBody* other, unsigned feature) const
+{
+	unsigned long long key = (unsigned long long)(size_t)one * 0x9e3779b97f4a7c15ULL;
+	key ^= (unsigned long long)(size_t)other + 0x632be59bd9b4e019ULL + (key << 6) + (key >> 2);
+	key ^= (unsigned long long)feature * 0xc2b2ae3d27d4eb4fULL;
+	key ^= key >> 29;
+	return (int)(key & (slots.size() - 1));
+}
+
+void ContactCache::keyBodies(const Contact &contact, RigidBody* &one, RigidBody* &other)
+{
+	one = contact.body[0];
+	other = contact.body[1];
+	if (one == NULL)
+	{
+		one = other;
+		other = NULL;
+	}
+}
+
+bool ContactCache::isLive(const Entry &entry) const
+{
+	return entry.frame != 0 && frame - entry.frame <= maxAge;
+}
+
+void ContactCache::rehash(int size)
+{
+	std::vector<Entry> old;
+	old.swap(slots);
+
+	Entry empty = { { NULL, NULL }, 0, 0, 0, 0 };
+	slots.assign(size, empty);
+	occupied = 0;
+
+	int mask = size - 1;
+	for (size_t i = 0; i < old.size(); i++)
+	{
+		if (!isLive(old[i]))
+			continue;
+
+		int slot = slotOf(old[i].body[0], old[i].body[1], old[i].feature);
+		while (slots[slot].frame != 0)
+			slot = (slot + 1) & mask;
+		slots[slot] = old[i];
+		occupied++;
+	}
+}
+
+void ContactCache::nextFrame()
+{
+	frame++;
+	hits = 0;
+}
+
+bool ContactCache::fetch(Contact *contact)
+{
+	RigidBody *one, *other;
+	keyBodies(*contact, one, other);
+
+	int mask = (int)slots.size() - 1;
+	int slot = slotOf(one, other, contact->feature);
+	for (; slots[slot].frame != 0; slot = (slot + 1) & mask)
+	{
+		const Entry& entry = slots[slot];
+		if (entry.body[0] == one && entry.body[1] == other &&
+			entry.feature == contact->feature)
+		{
+			if (!isLive(entry))
+				return false;
+			contact->normalImpulse = entry.normalImpulse;
+			contact->tangentImpulse = entry.tangentImpulse;
+			hits++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ContactCache::store(const Contact &contact)
+{
+	// keep the table at most half full, counting stale entries; the
+	// rehash drops them and doubles only if the live ones need it
+	if (2 * (occupied + 1) > (int)slots.size())
+	{
+		int live = 0;
+		for (size_t i = 0; i < slots.size(); i++)
+			if (isLive(slots[i]))
+				live++;
+		int size = (int)slots.size();
+		if (4 * (live + 1) > size)
+			size *= 2;
+		rehash(size);
+	}
+
+	RigidBody *one, *other;
+	keyBodies(contact, one, other);
+
+	int mask = (int)slots.size() - 1;
+	int slot = slotOf(one, other, contact.feature);
+	int reuse = -1;
+	for (; slots[slot].frame != 0; slot = (slot + 1) & mask)
+	{
+		Entry& entry = slots[slot];
+		if (entry.body[0] == one && entry.body[1] == other &&
+			entry.feature == contact.feature)
+		{
+			reuse = slot;
+			break;
+		}
+		if (reuse < 0 && !isLive(entry))
+			reuse = slot;
+	}
+
+	if (reuse < 0)
+	{
+		reuse = slot;
+		occupied++;
+	}
+
+	Entry& entry = slots[reuse];
+	entry.body[0] = one;
+	entry.body[1] = other;
+	entry.feature = contact.feature;
+	entry.frame = frame;
+	entry.normalImpulse = contact.normalImpulse;
+	entry.tangentImpulse = contact.tangentImpulse;
+}
+
+void ContactCache::clear()
+{
+	Entry empty = { { NULL, NULL }, 0, 0, 0, 0 };
+	slots.assign(slots.size(), empty);
+	occupied = 0;
+	hits = 0;
+}
+
+int ContactCache::getHits() const
+{
+	return hits;
+}
+
+int ContactCache::getOccupied() const
+{
+	return occupied;
+}
+
 void Contact::matchAwakeState()
 {
 	if (body[1] == NULL)
@@ -387,8 +1130,9 @@ void Contact::matchAwakeState()
 	bool isAwake0 = body[0]->getIsAwake();
 	bool isAwake1 = body[1]->getIsAwake();
 
-	if (isAwake0 && !isAwake1)
+	// immovable bodies are never woken, they may be shared between islands
+	if (isAwake0 && !isAwake1 && body[1]->isMovable())
 		body[1]->setAwake();
-	else if (!isAwake0 && isAwake1)
+	else if (!isAwake0 && isAwake1 && body[0]->isMovable())
 		body[0]->setAwake();
 }
\ No newline at end of file
@@ -2,9 +2,16 @@
 #define __CONTACTS_H_INCLUDED__
 
 
+#include <vector>
+
 #include "precision.h"
 #include "core.h"
 #include "body.h"
+#include "profile.h"
+#include "table.h"
+#include "heap.h"
+#include "island.h"
+#include "jobs.h"
 
 class Contact
 {
@@ -17,12 +24,20 @@ public:
 	Vector2 contactPoint;
 	Vector2 contactNormal; // from perspective of body[0]
 	real penetration;
+	// tells the contacts of one body pair apart from frame to frame
+	// (vertex, face, plane or generator), 0 from setBodyData
+	unsigned feature;
 
 	Vector2 linearChange[2];
 	real angularChange[2];
 	Vector2 velocityChange[2];
 	real rotationChange[2];
 
+	// accumulated over the sweeps of the sequential impulse mode, carried
+	// to the next resolve for warm starting
+	real normalImpulse;
+	real tangentImpulse;
+
 public:
 	void setBodyData(RigidBody* body1, RigidBody* body2,
 		real friction, real restitution);
@@ -33,6 +48,14 @@ protected:
 	Vector2 contactVelocity; // local space
 	real desiredDeltaVelocity; // local space
 
+	// sequential impulse data, set by ContactResolver::prepareImpulses
+	real inverseMass[2]; // 0 for no body, immovable or asleep
+	real inverseMomentOfInertia[2];
+	real normalMass;
+	real tangentMass;
+	real velocityBias; // restitution target for the normal velocity
+	real positionImpulse; // accumulated split impulse
+
 protected:
 	void calculateInternals(real duration);
 	void swapBodies();
@@ -44,18 +67,154 @@ protected:
 	Vector2 calculateFrictionImpulse();
 	void applyVelocityChange();
 	void applyPositionChange(); // resolve penetration
+	void applyImpulse(const Vector2 &impulse); // world space, to awake bodies
+	Vector2 calculateRelativeVelocity() const; // world space, body[0] - body[1]
 
 	void matchAwakeState();
 };
 
+// Accumulated impulses of contacts that persist from frame to frame,
+// keyed by (body[0], body[1], feature) with the bodies in the order
+// calculateInternals leaves them, a NULL body second, so a contact is
+// found whether or not it has been swapped yet; swapping inverts the
+// normal and tangent but not the impulses along them. Open addressing
+// with linear probing; an entry not stored again for more than maxAge
+// frames is stale and its slot is reused by the next insert on its probe
+// path. Stale entries are dropped for good when the table is rehashed.
+class ContactCache
+{
+protected:
+	struct Entry
+	{
+		RigidBody* body[2];
+		unsigned feature;
+		unsigned frame; // last frame the entry was stored, 0 for empty
+		real normalImpulse;
+		real tangentImpulse;
+	};
+
+	std::vector<Entry> slots; // size is a power of two
+	int occupied; // live and stale entries
+	unsigned frame;
+	unsigned maxAge;
+	int hits;
+
+protected:
+	int slotOf(RigidBody* one, RigidBody* other, unsigned feature) const;
+	// the contact's bodies in key order
+	static void keyBodies(const Contact &contact, RigidBody* &one, RigidBody* &other);
+	bool isLive(const Entry &entry) const;
+	void rehash(int size);
+
+public:
+	ContactCache(int capacity = 1024, unsigned maxAge = 1);
+
+	// ages every entry by one frame
+	void nextFrame();
+	// copies the stored impulses into the contact, false if there are none
+	bool fetch(Contact *contact);
+	void store(const Contact &contact);
+	void clear();
+
+	// accessor
+	int getHits() const; // fetches that found an entry since nextFrame
+	int getOccupied() const;
+};
+
+enum ResolverMode
+{
+	// one contact at a time, worst first (Millington)
+	RESOLVE_WORST_FIRST,
+	// fixed sweeps over all contacts with clamped accumulated impulses
+	// (projected Gauss-Seidel), warm started from the last resolve;
+	// penetration is removed by split impulses that move the bodies
+	// without adding velocity
+	RESOLVE_SEQUENTIAL_IMPULSE
+};
+
 class ContactResolver
 {
+public:
+	// groups with fewer contacts are swept in order, larger ones by colour
+	static const int BATCH_MIN_CONTACTS = 64;
+	static const int BATCH_CHUNK = 32; // contacts per job
+	static const int MAX_COLOURS = 64; // further contacts share a serial batch
+
 protected:
+	// scratch of one resolveGroup; one per job system thread so islands
+	// can be resolved side by side
+	struct Workspace
+	{
+		// contacts touching each body, rebuilt by prepareContacts so an
+		// iteration only revisits the contacts that share a body with the
+		// one it resolved
+		HashTable bodyTable; // body pointer -> body slot
+		std::vector<int> contactBodySlot; // 2 per contact, -1 for no body
+		std::vector<int> bodyContactStart; // slot -> first entry in bodyContacts
+		std::vector<int> bodyContacts;
+		std::vector<RigidBody*> slotBodies; // slot -> body
+		std::vector<int> touched; // iteration that last touched each contact
+		std::vector<int> updated;
+		IndexedHeap heap; // worst contact on top
+		std::vector<Vector2> displacement; // split impulse result by body slot
+		std::vector<real> rotation;
+		// sequential impulse contacts by colour: no two contacts of a
+		// batch share a movable body; empty for groups too small to colour
+		std::vector<unsigned long long> slotColours; // colours used per slot
+		std::vector<int> batchStart; // colour -> first entry in batchContacts
+		std::vector<int> batchContacts;
+		std::vector<int> contactColour; // colouring scratch, -1 for none
+		std::vector<int> batchFill; // next free entry per colour
+		int positionIterationUsed;
+		int velocityIterationUsed;
+	};
+
+	// one colour of a sweep, split into chunks for the job system
+	struct BatchPass
+	{
+		ContactResolver *resolver;
+		Workspace *work;
+		Contact *contactArray;
+		const int *contacts; // entries of batchContacts
+		int count;
+		bool positions; // split impulse sweep, else velocity sweep
+	};
+
+	// an awake island handed to resolveGroup
+	struct IslandTask
+	{
+		int start; // first entry in islandContacts
+		int count;
+		int positionIteration;
+		int velocityIteration;
+		int positionIterationUsed;
+		int velocityIterationUsed;
+	};
+
+	ResolverMode mode;
 	int positionIteration;
 	int velocityIteration;
 	real positionEpsilon;
 	real velocityEpsilon;
 
+	real positionCorrection; // share of the penetration removed per resolve
+	real penetrationSlop; // penetration left alone, keeps contacts alive
+	ContactCache cache; // impulses of the last resolves, for warm starting
+
+	// resolve each island on its own and skip the sleeping ones
+	bool useIslands;
+	IslandGraph islands;
+	std::vector<int> contactIsland;
+	std::vector<int> islandStart; // island -> first entry in islandContacts
+	std::vector<int> islandFill; // next free entry per island while grouping
+	std::vector<int> islandOrder; // entry -> index in the caller's array
+	std::vector<Contact> islandContacts;
+	std::vector<IslandTask> tasks;
+
+	JobSystem *jobs; // NULL to resolve on the calling thread
+	std::vector<Workspace> workspaces; // by JobSystem::getThreadIndex
+	real taskDuration; // duration of the resolve the tasks belong to
+
 public:
 	int positionIterationUsed;
 	int velocityIterationUsed;
@@ -66,16 +225,45 @@ public:
 		real velocityEpsilon = (real)0.0,
 		real positionEpsilon = (real)0.0);
 	void setIterations(int velocityIteration, int positionIteration);
+	void setMode(ResolverMode mode);
+	ResolverMode getMode() const;
+	void setPositionCorrection(real positionCorrection, real penetrationSlop);
+	ContactCache& getCache();
+	void setIslands(bool islands);
+	IslandGraph& getIslands(); // islands of the last resolve
+	// awake islands (with setIslands(true)) and the colour batches of
+	// large groups are spread over the job system's threads, NULL
+	// resolves everything on the calling thread
+	void setJobSystem(JobSystem *jobs);
 	void resolveContacts(Contact *contactArray,
 		int numContacts, real duration);
 
 protected:
-	void prepareContacts(Contact *contactArray, 
-		int numContacts, real duration);
-	void adjustPositions(Contact *contactArray,
-		int numContacts, real duration);
-	void adjustVelocities(Contact *contactArray,
+	void prepareContacts(Workspace &work, Contact *contactArray,
 		int numContacts, real duration);
+	void adjustPositions(Workspace &work, Contact *contactArray,
+		int numContacts, real duration, int positionIteration);
+	void adjustVelocities(Workspace &work, Contact *contactArray,
+		int numContacts, real duration, int velocityIteration);
+	void resolveGroup(Workspace &work, Contact *contactArray,
+		int numContacts, real duration, int positionIteration, int velocityIteration);
+	void buildBodyContacts(Workspace &work, Contact *contactArray, int numContacts);
+	static void resolveTask(void *resolver, int index);
+
+	// sequential impulse mode
+	void fetchImpulses(Contact *contactArray, int numContacts);
+	void prepareImpulses(Contact *contactArray, int numContacts);
+	void warmStart(Contact *contactArray, int numContacts);
+	void colourContacts(Workspace &work, Contact *contactArray, int numContacts);
+	void solveVelocities(Workspace &work, Contact *contactArray,
+		int numContacts, int velocityIteration);
+	void solvePositions(Workspace &work, Contact *contactArray,
+		int numContacts, int positionIteration);
+	void solveVelocity(Contact &contact);
+	void solvePosition(Workspace &work, Contact *contactArray, int index);
+	void solveBatches(Workspace &work, Contact *contactArray, bool positions);
+	static void solveBatchChunk(void *pass, int chunk);
+	void storeImpulses(Contact *contactArray, int numContacts);
 };
 
 class ContactGenerator
@@ -33,14 +33,14 @@ RigidBodyApplication()
 	for (int i = 0; i < ROW_NUM; i++)
 		for (int j = 0; j < ROW_NUM; j++)
 		{
-			sphere_bodies[i][j] = RigidBody(sphereStackPosition
+			sphere_bodies[i][j] = RigidBody(world.getBodyStore(), sphereStackPosition
 				+ sphereStackGapX * i + sphereStackGapY * j * 0.1,
 				Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
 		}
 
 	for (int i = 0; i < BOX_NUM; i++)
 	{
-		box_bodies[i] = RigidBody(boxStackPosition + boxStackGap * i,
+		box_bodies[i] = RigidBody(world.getBodyStore(), boxStackPosition + boxStackGap * i,
 			Vector2(1, 0.0), 1.0f / boxMass, 1.0f / boxMOI);
 	}
 
@@ -51,6 +51,14 @@ RigidBodyApplication()
 	for (int i = 0; i < BOX_NUM; i++)
 		boxes[i] = CollisionBox(&box_bodies[i], boxHalfSize);
 
+	// cloth nodes collide with the box, not with each other
+	for (int i = 0; i < SPHERE_NUM; i++)
+		collisionSpace.add(&spheres[i], 2, 1);
+	for (int i = 0; i < BOX_NUM; i++)
+		collisionSpace.add(&boxes[i]);
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
 	// joints
 	real length = gap;
 	real restitution = 0.5;
@@ -104,26 +112,7 @@ RigidBodyApplication()
 void CurtainApp::generateContacts()
 {
 	collisionData.reset();
-
-	/*for (int i = 0; i < SPHERE_NUM; i++)
-		for (int j = i + 1; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndSphere(spheres[i], spheres[j], &collisionData);*/
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = i + 1; j < BOX_NUM; j++)
-			CollisionDetector::boxAndBox2(boxes[i], boxes[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::boxAndSphere(boxes[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < PLANE_NUM; i++)
-	{
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndHalfSpace(spheres[j], planes[i], &collisionData);
-		for (int j = 0; j < BOX_NUM; j++)
-			CollisionDetector::boxAndHalfSpace(boxes[j], planes[i], &collisionData);
-	}
+	collisionSpace.generateContacts(&collisionData);
 }
 
 void CurtainApp::display()
@@ -1,8 +1,6 @@
 #ifndef __CURTAIN_H_INCLUDED__
 #define __CURTAIN_H_INCLUDED__
 
-#include <windows.h>
-#include <GL/glut.h>
 #include <iostream>
 
 #include "precision.h"
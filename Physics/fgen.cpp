@@ -1,18 +1,67 @@
 #include "fgen.h"
+#include "simd.h"
+
+void ForceGenerator::updateForces(BodyStore &store, RigidBody *const *bodies,
+	const unsigned *slots, int count, real duration)
+{
+	for (int i = 0; i < count; i++)
+		updateForce(bodies[i], duration);
+}
 
 void ForceRegistry::add(RigidBody *body, ForceGenerator *fg)
 {
-	ForceRegistration registration;
-	registration.body = body;
-	registration.fg = fg;
-	registrations.push_back(registration);
+	Registry::iterator i = groups.begin();
+	for (; i != groups.end(); i++)
+		if (i->fg == fg && i->store == body->getStore())
+			break;
+	if (i == groups.end())
+	{
+		groups.push_back(ForceGroup());
+		i = groups.end() - 1;
+		i->fg = fg;
+		i->store = body->getStore();
+	}
+	// a body is added to a generator at most once; the kernels would
+	// otherwise load a slot twice and keep only one lane's force
+	for (size_t k = 0; k < i->bodies.size(); k++)
+		if (i->bodies[k] == body)
+			return;
+	i->bodies.push_back(body);
+	i->slots.push_back(body->getHandle().index);
+}
+
+void ForceRegistry::remove(RigidBody *body, ForceGenerator *fg)
+{
+	Registry::iterator i = groups.begin();
+	for (; i != groups.end(); i++)
+	{
+		if (i->fg != fg || i->store != body->getStore())
+			continue;
+		for (size_t k = 0; k < i->bodies.size(); k++)
+		{
+			if (i->bodies[k] != body)
+				continue;
+			i->bodies.erase(i->bodies.begin() + k);
+			i->slots.erase(i->slots.begin() + k);
+			break;
+		}
+		if (i->bodies.empty())
+			groups.erase(i);
+		return;
+	}
+}
+
+void ForceRegistry::clear()
+{
+	groups.clear();
 }
 
 void ForceRegistry::updateForces(real duration)
 {
-	Registry::iterator i = registrations.begin();
-	for (; i != registrations.end(); i++)
-		i->fg->updateForce(i->body, duration);
+	Registry::iterator i = groups.begin();
+	for (; i != groups.end(); i++)
+		i->fg->updateForces(*i->store, &i->bodies[0], &i->slots[0],
+			(int)i->bodies.size(), duration);
 }
 
 Gravity::Gravity(const Vector2& gravity, bool on)
@@ -40,6 +89,45 @@ void Gravity::updateForce(RigidBody *body, real duration)
 	body->addForce(gravity * body->getMass());
 }
 
+// Gravity::updateForce on slots[0, LANES), one body per lane
+template<class Lane, int LANES>
+static void gravityLanes(BodyStore &store, const unsigned *slots, const Vector2 &gravity)
+{
+	real awake[LANES];
+	for (int l = 0; l < LANES; l++)
+		awake[l] = store.isAwake[slots[l]];
+
+	bool run = isSlotRun<LANES>(slots);
+	Lane tag = Lane();
+	Lane zero = simdSet((real)0.0, tag);
+	Lane inverse = loadSlots<Lane, LANES>(store.inverseMass, slots, run);
+	// bodies of infinite mass and sleeping ones get nothing
+	Lane apply = simdAnd(simdGreater(inverse, zero),
+		simdGreater(simdLoad(awake, tag), zero));
+	Lane mass = simdDiv(simdSet((real)1.0, tag),
+		simdSelect(apply, inverse, simdSet((real)1.0, tag)));
+	Lane forceX = loadSlots<Lane, LANES>(store.forceX, slots, run);
+	Lane forceY = loadSlots<Lane, LANES>(store.forceY, slots, run);
+	forceX = simdSelect(apply, simdAdd(forceX, simdMul(simdSet(gravity.x, tag), mass)), forceX);
+	forceY = simdSelect(apply, simdAdd(forceY, simdMul(simdSet(gravity.y, tag), mass)), forceY);
+
+	storeSlots<Lane, LANES>(store.forceX, slots, run, forceX);
+	storeSlots<Lane, LANES>(store.forceY, slots, run, forceY);
+}
+
+void Gravity::updateForces(BodyStore &store, RigidBody *const *bodies,
+	const unsigned *slots, int count, real duration)
+{
+	if (gravity.magnitude() == 0 || !on)
+		return;
+
+	int k = 0;
+	for (; k + SIMD_LANES <= count; k += SIMD_LANES)
+		gravityLanes<SimdReal, SIMD_LANES>(store, slots + k, gravity);
+	for (; k < count; k++)
+		gravityLanes<real, 1>(store, slots + k, gravity);
+}
+
 Spring::Spring()
 {}
 
@@ -101,6 +189,135 @@ void Field::setSource(const Vector2& s)
 	source = s;
 }
 
+MutualGravity::MutualGravity(real G, real theta, real softening)
+{
+	this->G = G;
+	this->theta = theta;
+	this->softening = softening;
+	jobs = NULL;
+	store = NULL;
+	slots = NULL;
+	count = 0;
+}
+
+void MutualGravity::fieldAt(real px, real py, int skip,
+	real &fieldX, real &fieldY) const
+{
+	if (theta > 0)
+	{
+		tree.field(px, py, skip, theta, softening, fieldX, fieldY);
+		return;
+	}
+
+	// the direct sum, in the same form as the tree's leaves
+	real softeningSquare = softening * softening;
+	real sumX = 0, sumY = 0;
+	for (int j = 0; j < count; j++)
+	{
+		if (j == skip)
+			continue;
+
+		real dx = x[j] - px;
+		real dy = y[j] - py;
+		real distanceSquare = dx * dx + dy * dy + softeningSquare;
+		if (distanceSquare == 0)
+			continue;
+
+		real inverse = 1 / distanceSquare;
+		real scale = mass[j] * inverse * real_sqrt(inverse);
+		sumX += scale * dx;
+		sumY += scale * dy;
+	}
+	fieldX = sumX;
+	fieldY = sumY;
+}
+
+void MutualGravity::updateForce(RigidBody *body, real duration)
+{
+	if (!body->isFiniteMass() || !body->getIsAwake())
+		return;
+
+	Vector2 position = body->getPosition();
+	real fieldX, fieldY;
+	fieldAt(position.x, position.y, -1, fieldX, fieldY);
+	body->addForce(Vector2(fieldX, fieldY) * (G * body->getMass()));
+}
+
+// the bodies [chunk * CHUNK, chunk * CHUNK + CHUNK) of the group; each
+// writes the force of its own slots only
+void MutualGravity::forceChunk(void *data, int chunk)
+{
+	MutualGravity *gravity = (MutualGravity*)data;
+	BodyStore &store = *gravity->store;
+	int begin = chunk * CHUNK;
+	int end = begin + CHUNK;
+	if (end > gravity->count)
+		end = gravity->count;
+
+	for (int i = begin; i < end; i++)
+	{
+		unsigned slot = gravity->slots[i];
+		if (gravity->mass[i] == 0 || !store.isAwake[slot])
+			continue;
+
+		real fieldX, fieldY;
+		gravity->fieldAt(gravity->x[i], gravity->y[i], i, fieldX, fieldY);
+		real scale = gravity->G * gravity->mass[i];
+		store.forceX[slot] += fieldX * scale;
+		store.forceY[slot] += fieldY * scale;
+	}
+}
+
+void MutualGravity::updateForces(BodyStore &store, RigidBody *const *bodies,
+	const unsigned *slots, int count, real duration)
+{
+	this->store = &store;
+	this->slots = slots;
+	this->count = count;
+	x.resize(count);
+	y.resize(count);
+	mass.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		unsigned slot = slots[i];
+		x[i] = store.positionX[slot];
+		y[i] = store.positionY[slot];
+		mass[i] = store.inverseMass[slot] > 0 ? 1 / store.inverseMass[slot] : 0;
+	}
+	if (count == 0 || G == 0)
+		return;
+
+	if (theta > 0)
+		tree.build(&x[0], &y[0], &mass[0], count);
+
+	int chunks = (count + CHUNK - 1) / CHUNK;
+	if (jobs != NULL)
+		jobs->parallelFor(chunks, forceChunk, this);
+	else
+		for (int c = 0; c < chunks; c++)
+			forceChunk(this, c);
+}
+
+real MutualGravity::getOpeningAngle() const
+{
+	return theta;
+}
+
+void MutualGravity::setOpeningAngle(real theta)
+{
+	this->theta = theta;
+}
+
+void MutualGravity::setSoftening(real softening)
+{
+	this->softening = softening;
+}
+
+void MutualGravity::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+}
+
 Aero::Aero(const Matrix2 &tensor, const Vector2 &position,
 	const Vector2 *windSpeed)
 {
@@ -121,6 +338,72 @@ void Aero::updateForce(RigidBody *body, real duration)
 	body->addForceAtBodyPoint(forceWorld, position);
 }
 
+// Aero::updateForce on slots[0, LANES), one body per lane, with the
+// same operations in the same order
+template<class Lane, int LANES>
+static void aeroLanes(BodyStore &store, const unsigned *slots, const Matrix2 &tensor,
+	const Vector2 &position, const Vector2 &wind)
+{
+	real m[6][LANES], awake[LANES];
+	for (int l = 0; l < LANES; l++)
+	{
+		unsigned i = slots[l];
+		for (int e = 0; e < 6; e++)
+			m[e][l] = store.transformMatrix[i].data[e];
+		awake[l] = store.isAwake[i];
+	}
+
+	bool run = isSlotRun<LANES>(slots);
+	Lane tag = Lane();
+	Lane m0 = simdLoad(m[0], tag), m1 = simdLoad(m[1], tag), m2 = simdLoad(m[2], tag);
+	Lane m3 = simdLoad(m[3], tag), m4 = simdLoad(m[4], tag), m5 = simdLoad(m[5], tag);
+
+	// no force without air speed
+	Lane velocityX = simdAdd(loadSlots<Lane, LANES>(store.velocityX, slots, run), simdSet(wind.x, tag));
+	Lane velocityY = simdAdd(loadSlots<Lane, LANES>(store.velocityY, slots, run), simdSet(wind.y, tag));
+	Lane still = simdEqual(simdAdd(simdMul(velocityX, velocityX), simdMul(velocityY, velocityY)),
+		simdSet((real)0.0, tag));
+
+	// into body space, through the tensor and back out
+	Lane bodyX = simdAdd(simdMul(velocityX, m0), simdMul(velocityY, m3));
+	Lane bodyY = simdAdd(simdMul(velocityX, m1), simdMul(velocityY, m4));
+	Lane forceBodyX = simdAdd(simdMul(simdSet(tensor.data[0], tag), bodyX),
+		simdMul(simdSet(tensor.data[1], tag), bodyY));
+	Lane forceBodyY = simdAdd(simdMul(simdSet(tensor.data[2], tag), bodyX),
+		simdMul(simdSet(tensor.data[3], tag), bodyY));
+	Lane forceX = simdAdd(simdMul(forceBodyX, m0), simdMul(forceBodyY, m1));
+	Lane forceY = simdAdd(simdMul(forceBodyX, m3), simdMul(forceBodyY, m4));
+
+	// applied at the body point position
+	Lane pointX = simdSet(position.x, tag), pointY = simdSet(position.y, tag);
+	Lane armX = simdSub(simdAdd(simdAdd(simdMul(m0, pointX), simdMul(m1, pointY)), m2),
+		loadSlots<Lane, LANES>(store.positionX, slots, run));
+	Lane armY = simdSub(simdAdd(simdAdd(simdMul(m3, pointX), simdMul(m4, pointY)), m5),
+		loadSlots<Lane, LANES>(store.positionY, slots, run));
+	Lane turn = simdSub(simdMul(armX, forceY), simdMul(armY, forceX));
+
+	Lane oldX = loadSlots<Lane, LANES>(store.forceX, slots, run);
+	Lane oldY = loadSlots<Lane, LANES>(store.forceY, slots, run);
+	Lane oldTorque = loadSlots<Lane, LANES>(store.torqueAccum, slots, run);
+	storeSlots<Lane, LANES>(store.forceX, slots, run, simdSelect(still, oldX, simdAdd(oldX, forceX)));
+	storeSlots<Lane, LANES>(store.forceY, slots, run, simdSelect(still, oldY, simdAdd(oldY, forceY)));
+	storeSlots<Lane, LANES>(store.torqueAccum, slots, run,
+		simdSelect(still, oldTorque, simdAdd(oldTorque, turn)));
+	simdStore(awake, simdSelect(still, simdLoad(awake, tag), simdSet((real)1.0, tag)));
+	for (int l = 0; l < LANES; l++)
+		store.isAwake[slots[l]] = awake[l] != 0;
+}
+
+void Aero::updateForces(BodyStore &store, RigidBody *const *bodies,
+	const unsigned *slots, int count, real duration)
+{
+	int k = 0;
+	for (; k + SIMD_LANES <= count; k += SIMD_LANES)
+		aeroLanes<SimdReal, SIMD_LANES>(store, slots + k, tensor, position, *windSpeed);
+	for (; k < count; k++)
+		aeroLanes<real, 1>(store, slots + k, tensor, position, *windSpeed);
+}
+
 Buoyancy::Buoyancy(real maxDepth, real volume, real waterHeight,
 	real liquidDensity, Vector2 centerOfBuoyancy)
 {
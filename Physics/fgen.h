@@ -7,30 +7,43 @@
 #include "precision.h"
 #include "core.h"
 #include "body.h"
+#include "quadtree.h"
+#include "jobs.h"
 
 class ForceGenerator
 {
 public:
 	virtual void updateForce(RigidBody *body, real duration) = 0;
+	// updateForce on each body, slots[i] being the slot of bodies[i] in
+	// store; generators with a kernel over the store's columns override it
+	virtual void updateForces(BodyStore &store, RigidBody *const *bodies,
+		const unsigned *slots, int count, real duration);
 };
 
+// Registrations are grouped by generator and store, so each generator
+// gets one call over all of its bodies instead of one virtual call per
+// body. A body is added to a generator at most once.
 class ForceRegistry
 {
 protected:
-	struct ForceRegistration
+	struct ForceGroup
 	{
-		RigidBody *body;
 		ForceGenerator *fg;
+		BodyStore *store; // of the bodies
+		std::vector<RigidBody*> bodies;
+		std::vector<unsigned> slots; // slot of each body in store
 	};
 
-	typedef std::vector<ForceRegistration> Registry;
-	Registry registrations;
+	// in the order the generators were first added
+	typedef std::vector<ForceGroup> Registry;
+	Registry groups;
 
 public:
+	// does nothing if the body is already registered with fg
 	void add(RigidBody *body, ForceGenerator *fg);
 	void remove(RigidBody *body, ForceGenerator *fg);
 	void clear();
-	// calls updateForce for every registored ForceGenerator
+	// calls updateForces for every registored ForceGenerator
 	void updateForces(real duration);
 };
 
@@ -43,6 +56,9 @@ public:
 public:
 	Gravity(const Vector2& gravity, bool isOn);
 	virtual void updateForce(RigidBody *body, real duration);
+	// SIMD_LANES bodies at a time (simd.h)
+	virtual void updateForces(BodyStore &store, RigidBody *const *bodies,
+		const unsigned *slots, int count, real duration);
 
 	void setGravity(const Vector2& gravity);
 	void setOn(bool on);
@@ -80,6 +96,50 @@ public:
 	void setSource(const Vector2& s);
 };
 
+// Every body of the group pulls every other, F = G m1 m2 / d^2 with d^2
+// softened to d^2 + softening^2; G < 0 pushes them apart, like charges.
+// Each updateForces rebuilds a BarnesHutTree over the group and sums the
+// field at every awake body, CHUNK bodies per job on the JobSystem when
+// one is set. Bodies of infinite mass neither pull nor move.
+//
+// theta is the opening angle: 0 sums every pair directly, the exact
+// O(n^2) reference; 0.5 is about 1% off it (RMS over the bodies).
+class MutualGravity : public ForceGenerator
+{
+public:
+	static const int CHUNK = 64;
+
+protected:
+	real G;
+	real theta;
+	real softening;
+	JobSystem *jobs;
+
+	// the group of the last updateForces, by position in the group
+	BarnesHutTree tree;
+	std::vector<real> x, y, mass;
+	BodyStore *store;
+	const unsigned *slots;
+	int count;
+
+protected:
+	// G / m1 times the force on (fieldX, fieldY) from the group
+	void fieldAt(real px, real py, int skip, real &fieldX, real &fieldY) const;
+	static void forceChunk(void *data, int chunk);
+
+public:
+	MutualGravity(real G, real theta = (real)0.5, real softening = 0);
+	// the pull of the group of the last updateForces on one body
+	virtual void updateForce(RigidBody *body, real duration);
+	virtual void updateForces(BodyStore &store, RigidBody *const *bodies,
+		const unsigned *slots, int count, real duration);
+
+	real getOpeningAngle() const;
+	void setOpeningAngle(real theta);
+	void setSoftening(real softening);
+	void setJobSystem(JobSystem *jobs); // NULL for single threaded
+};
+
 class Aero : public ForceGenerator
 {
 private:
@@ -91,6 +151,9 @@ public:
 	Aero(const Matrix2 &tensor, const Vector2 &position, 
 		const Vector2 *windSpeed);
 	virtual void updateForce(RigidBody *body, real duration);
+	// SIMD_LANES bodies at a time (simd.h)
+	virtual void updateForces(BodyStore &store, RigidBody *const *bodies,
+		const unsigned *slots, int count, real duration);
 };
 
 class Buoyancy : public ForceGenerator
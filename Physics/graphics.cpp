@@ -1,5 +1,27 @@
 #include "graphics.h"
 
+// where the draw calls take body poses from, NULL for the bodies' own
+static const BodySnapshot *drawSnapshot = NULL;
+static real drawAlpha = 1;
+
+void setDrawSnapshot(const BodySnapshot *snapshot, real alpha)
+{
+	drawSnapshot = snapshot;
+	drawAlpha = alpha;
+}
+
+static Matrix3 bodyTransform(const RigidBody *body)
+{
+	if (drawSnapshot != NULL)
+		return drawSnapshot->getTransform(body->getHandle().index, drawAlpha);
+	return body->getTransformMatrix();
+}
+
+static Matrix3 primitiveTransform(const CollisionPrimitive *primitive)
+{
+	return bodyTransform(primitive->body) * primitive->offset;
+}
+
 void drawAxis()
 {
 	glBegin(GL_LINES);
@@ -93,13 +115,15 @@ void drawParticle(Particle *p)
 
 void drawRigidBody(RigidBody *body)
 {
-	if (!body->getIsAwake())
+	bool awake = drawSnapshot != NULL ?
+		drawSnapshot->isAwake[body->getHandle().index] != 0 : body->getIsAwake();
+	if (!awake)
 		glColor3fv(SECONDARY_COLOR);
 	else
 		glColor3fv(OBJECT_COLOR);
 
 	float m[16];
-	body->getTransformMatrix().fillGLMatrix(m);
+	bodyTransform(body).fillGLMatrix(m);
 
 	glPushMatrix();
 	{
@@ -113,25 +137,38 @@ void drawRigidBody(RigidBody *body)
 
 void drawSpring(RigidBody *body, Spring *spring)
 {
-	Vector2 c1 = body->getPointInWorldSpace(spring->connectionPoint);
-	Vector2 c2 = spring->other->getPointInWorldSpace(spring->otherConnectionPoint);
+	Vector2 c1 = bodyTransform(body) * spring->connectionPoint;
+	Vector2 c2 = bodyTransform(spring->other) * spring->otherConnectionPoint;
 	drawLine(c1, c2);
 }
 
-void drawContact(Contact *contact)
+static void drawContactAt(const Vector2 &point, const Vector2 &depth)
 {
 	glPushMatrix();
 	{
-		glTranslatef(contact->contactPoint.x, contact->contactPoint.y, 0);
-		drawVector2(contact->contactNormal * -contact->penetration);
+		glTranslatef(point.x, point.y, 0);
+		drawVector2(depth);
 		glScalef(0.01, 0.01, 1);
 		drawCircle();
 	}
 	glPopMatrix();
 }
 
+void drawContact(Contact *contact)
+{
+	drawContactAt(contact->contactPoint, contact->contactNormal * -contact->penetration);
+}
+
+// from a snapshot, its own contacts; data may be in the middle of a step
 void drawCollisionData(CollisionData *data)
 {
+	if (drawSnapshot != NULL)
+	{
+		for (size_t i = 0; i < drawSnapshot->contactPoint.size(); i++)
+			drawContactAt(drawSnapshot->contactPoint[i], drawSnapshot->contactDepth[i]);
+		return;
+	}
+
 	for (int i = 0; i < data->contactsCount; i++)
 		drawContact(&(data->contactArray[i]));
 }
@@ -139,7 +176,7 @@ void drawCollisionData(CollisionData *data)
 void drawCollisionSphere(CollisionSphere *sphere)
 {
 	float m[16];
-	sphere->body->getTransformMatrix().fillGLMatrix(m);
+	primitiveTransform(sphere).fillGLMatrix(m);
 
 	glPushMatrix();
 	{
@@ -154,7 +191,7 @@ void drawCollisionSphere(CollisionSphere *sphere)
 void drawCollisionBox(CollisionBox *box)
 {
 	float m[16];
-	box->body->getTransformMatrix().fillGLMatrix(m);
+	primitiveTransform(box).fillGLMatrix(m);
 
 	glPushMatrix();
 	{
@@ -166,6 +203,22 @@ void drawCollisionBox(CollisionBox *box)
 	glPopMatrix();
 }
 
+void drawCollisionPolygon(CollisionPolygon *polygon)
+{
+	float m[16];
+	primitiveTransform(polygon).fillGLMatrix(m);
+
+	glPushMatrix();
+	{
+		glMultMatrixf(m);
+		glBegin(GL_LINE_LOOP);
+		for (int i = 0; i < polygon->vertexCount; i++)
+			glVertex2f((float)polygon->vertices[i].x, (float)polygon->vertices[i].y);
+		glEnd();
+	}
+	glPopMatrix();
+}
+
 void drawCollisionPlane(CollisionPlane *plane)
 {
 	glPushMatrix();
@@ -225,7 +278,7 @@ void drawParticleField(ParticleField *field)
 
 void drawJointAnchored(JointAnchored *jointAnchored)
 {
-	Vector2 a_pos_world = jointAnchored->body->getPosition();
+	Vector2 a_pos_world = bodyTransform(jointAnchored->body).getAxis(2);
 	Vector2 b_pos_world = jointAnchored->position[1];
 
 	drawLine(a_pos_world, b_pos_world);
@@ -233,8 +286,8 @@ void drawJointAnchored(JointAnchored *jointAnchored)
 
 void drawLink(Link *link)
 {
-	Vector2 a_pos_world = link->body[0]->getPosition();
-	Vector2 b_pos_world = link->body[1]->getPosition();
+	Vector2 a_pos_world = bodyTransform(link->body[0]).getAxis(2);
+	Vector2 b_pos_world = bodyTransform(link->body[1]).getAxis(2);
 
 	drawLine(a_pos_world, b_pos_world);
 }
\ No newline at end of file
@@ -2,8 +2,16 @@
 #define __GRAPHICS_H_INCLUDED__
 
 
+#ifdef PHYSICS_HEADLESS
+// no display: draw calls compile against the stubs in graphics_null.cpp
+typedef float GLfloat;
+inline void glColor3fv(const GLfloat *v) {}
+#else
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <GL/glut.h>
+#endif
 #include <iostream>
 
 #include "precision.h"
@@ -20,6 +28,7 @@
 #include "joints.h"
 #include "world.h"
 #include "collide_fine.h"
+#include "snapshot.h"
 
 const GLfloat gray = 0.8f;
 const GLfloat lightGray = 0.2f;
@@ -27,6 +36,12 @@ const GLfloat backGround = 0.1f;
 const GLfloat OBJECT_COLOR[3] = { gray, gray, gray };
 const GLfloat SECONDARY_COLOR[3] = { lightGray, lightGray, 1.0f };
 
+// Non-NULL makes the draw calls take body poses, awake flags and the
+// contacts from the snapshot instead of the live bodies, for drawing
+// while another thread steps them (PhysicsThread). The poses are blended
+// by alpha from before the snapshot's tick to after it.
+void setDrawSnapshot(const BodySnapshot *snapshot, real alpha = 1);
+
 void drawAxis();
 void drawMouse(Vector2 position, real radius);
 void drawCircle();
@@ -41,6 +56,7 @@ void drawContact(Contact *contact);
 void drawCollisionData(CollisionData *data);
 void drawCollisionSphere(CollisionSphere *sphere);
 void drawCollisionBox(CollisionBox *box);
+void drawCollisionPolygon(CollisionPolygon *polygon);
 void drawCollisionPlane(CollisionPlane *plane);
 void drawTrace(Particle *p);
 void drawParticleLink(ParticleLink *pl);
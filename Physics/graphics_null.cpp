@@ -0,0 +1,74 @@
+#include "graphics.h"
+
+// Headless replacement for graphics.cpp. The demo scenes keep their
+// display() code, but every draw call does nothing so the scenes can be
+// stepped without a window or an OpenGL context.
+
+void setDrawSnapshot(const BodySnapshot *snapshot, real alpha)
+{}
+
+void drawAxis()
+{}
+
+void drawMouse(Vector2 position, real radius)
+{}
+
+void drawSquare()
+{}
+
+void drawPolygon(float x[], float y[], const int N)
+{}
+
+void drawCircle()
+{}
+
+void drawVector2(const Vector2& v)
+{}
+
+void drawLine(const Vector2& v1, const Vector2& v2)
+{}
+
+void drawParticle(Particle *p)
+{}
+
+void drawRigidBody(RigidBody *body)
+{}
+
+void drawSpring(RigidBody *body, Spring *spring)
+{}
+
+void drawContact(Contact *contact)
+{}
+
+void drawCollisionData(CollisionData *data)
+{}
+
+void drawCollisionSphere(CollisionSphere *sphere)
+{}
+
+void drawCollisionBox(CollisionBox *box)
+{}
+
+void drawCollisionPolygon(CollisionPolygon *polygon)
+{}
+
+void drawCollisionPlane(CollisionPlane *plane)
+{}
+
+void drawTrace(Particle *p)
+{}
+
+void drawParticleLink(ParticleLink *pl)
+{}
+
+void drawField(Field *field)
+{}
+
+void drawParticleField(ParticleField *field)
+{}
+
+void drawJointAnchored(JointAnchored *jointAnchored)
+{}
+
+void drawLink(Link *link)
+{}
@@ -0,0 +1,89 @@
+#include "heap.h"
+
+void IndexedHeap::swap(int one, int other)
+{
+	int item = heap[one];
+	heap[one] = heap[other];
+	heap[other] = item;
+	position[heap[one]] = one;
+	position[heap[other]] = other;
+}
+
+void IndexedHeap::siftUp(int index)
+{
+	while (index > 0)
+	{
+		int parent = (index - 1) / 2;
+		if (keys[heap[parent]] >= keys[heap[index]])
+			break;
+		swap(index, parent);
+		index = parent;
+	}
+}
+
+void IndexedHeap::siftDown(int index)
+{
+	int count = (int)heap.size();
+	while (true)
+	{
+		int largest = index;
+		int left = 2 * index + 1;
+		int right = left + 1;
+		if (left < count && keys[heap[left]] > keys[heap[largest]])
+			largest = left;
+		if (right < count && keys[heap[right]] > keys[heap[largest]])
+			largest = right;
+		if (largest == index)
+			break;
+		swap(index, largest);
+		index = largest;
+	}
+}
+
+void IndexedHeap::reset(int count)
+{
+	keys.assign(count, -REAL_MAX);
+	heap.resize(count);
+	position.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		heap[i] = i;
+		position[i] = i;
+	}
+}
+
+void IndexedHeap::set(int item, real key)
+{
+	keys[item] = key;
+}
+
+void IndexedHeap::build()
+{
+	for (int i = (int)heap.size() / 2 - 1; i >= 0; i--)
+		siftDown(i);
+}
+
+void IndexedHeap::update(int item, real key)
+{
+	real old = keys[item];
+	keys[item] = key;
+	if (key > old)
+		siftUp(position[item]);
+	else if (key < old)
+		siftDown(position[item]);
+}
+
+int IndexedHeap::top() const
+{
+	return heap.empty() ? -1 : heap[0];
+}
+
+real IndexedHeap::getKey(int item) const
+{
+	return keys[item];
+}
+
+int IndexedHeap::size() const
+{
+	return (int)heap.size();
+}
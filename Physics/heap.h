@@ -0,0 +1,41 @@
+#ifndef __HEAP_H_INCLUDED__
+#define __HEAP_H_INCLUDED__
+
+
+#include <vector>
+
+#include "precision.h"
+
+// Binary max-heap over the items 0..count-1, each with a real key. The
+// heap keeps every item's position, so a changed key is fixed in
+// O(log n) without searching. Items are never removed: a resolved item
+// gets a new (usually small) key and sinks.
+class IndexedHeap
+{
+protected:
+	std::vector<real> keys; // by item
+	std::vector<int> heap; // items in heap order
+	std::vector<int> position; // item -> index in heap
+
+protected:
+	void swap(int one, int other);
+	void siftUp(int index);
+	void siftDown(int index);
+
+public:
+	// all keys start at -REAL_MAX, set them then call build
+	void reset(int count);
+	void set(int item, real key);
+	void build();
+
+	// restores the order after one key changed
+	void update(int item, real key);
+
+	// accessor, top is -1 when the heap is empty
+	int top() const;
+	real getKey(int item) const;
+	int size() const;
+};
+
+
+#endif // __HEAP_H_INCLUDED__
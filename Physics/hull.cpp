@@ -0,0 +1,107 @@
+#include "hull.h"
+
+HullApp::HullApp(bool boxes) :
+RigidBodyApplication()
+{
+	HullApp::boxes = boxes;
+
+	// walls
+	real wallDist = 0.9;
+	planes[0] = CollisionPlane(Vector2::Y, -wallDist);
+	planes[1] = CollisionPlane(-Vector2::Y, -wallDist);
+	planes[2] = CollisionPlane(Vector2::X, -wallDist * 2);
+	planes[3] = CollisionPlane(-Vector2::X, -wallDist * 2);
+
+	// octagon around a wide and a tall box
+	Vector2 wideHalfSize(0.10, 0.04);
+	Vector2 tallHalfSize(0.04, 0.10);
+	Vector2 octagon[8] =
+	{
+		Vector2(+0.10, -0.04), Vector2(+0.10, +0.04),
+		Vector2(+0.04, +0.10), Vector2(-0.04, +0.10),
+		Vector2(-0.10, +0.04), Vector2(-0.10, -0.04),
+		Vector2(-0.04, -0.10), Vector2(+0.04, -0.10)
+	};
+	real pieceMass = 1;
+	real pieceMOI = pieceMass * polygonMOIPerMass(octagon, 8);
+
+	// rows of six, each row shifted and turned a little
+	Vector2 pilePosition(-0.75, -wallDist + 0.3);
+	Vector2 pileGap(0.3, 0.25);
+	for (int i = 0; i < PIECE_NUM; i++)
+	{
+		int row = i / 6;
+		int column = i % 6;
+		Vector2 position = pilePosition + Vector2(pileGap.x * column + (row % 2) * 0.1,
+			pileGap.y * row);
+		real angle = 0.2 * (column - row);
+		bodies[i] = RigidBody(world.getBodyStore(),
+			position, Vector2(real_cos(angle), real_sin(angle)),
+			1.0f / pieceMass, 1.0f / pieceMOI);
+		bodies[i].setAwake();
+	}
+
+	for (int i = 0; i < PIECE_NUM; i++)
+	{
+		polygons[i] = CollisionPolygon(&bodies[i], octagon, 8);
+		crossBoxes[2 * i] = CollisionBox(&bodies[i], wideHalfSize);
+		crossBoxes[2 * i + 1] = CollisionBox(&bodies[i], tallHalfSize);
+	}
+
+	for (int i = 0; i < PIECE_NUM; i++)
+	{
+		if (boxes)
+		{
+			collisionSpace.add(&crossBoxes[2 * i]);
+			collisionSpace.add(&crossBoxes[2 * i + 1]);
+		}
+		else
+			collisionSpace.add(&polygons[i]);
+	}
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
+	// assign to world
+	for (int i = 0; i < PIECE_NUM; i++)
+		world.getRigidBodies().push_back(&bodies[i]);
+
+	World::RigidBodies::iterator i = world.getRigidBodies().begin();
+	for (; i != world.getRigidBodies().end(); i++)
+	{
+		world.getForceRegistry().add((*i), &gravity);
+		world.getForceRegistry().add((*i), &field);
+		world.getForceRegistry().add((*i), &aero);
+	}
+}
+
+void HullApp::generateContacts()
+{
+	collisionData.reset();
+	collisionSpace.generateContacts(&collisionData);
+}
+
+void HullApp::display()
+{
+	World::RigidBodies::iterator i = world.getRigidBodies().begin();
+	for (; i != world.getRigidBodies().end(); i++)
+		drawRigidBody(*i);
+
+	glColor3fv(OBJECT_COLOR);
+	for (int i = 0; i < PIECE_NUM; i++)
+	{
+		if (boxes)
+		{
+			drawCollisionBox(&crossBoxes[2 * i]);
+			drawCollisionBox(&crossBoxes[2 * i + 1]);
+		}
+		else
+			drawCollisionPolygon(&polygons[i]);
+	}
+	for (int i = 0; i < PLANE_NUM; i++)
+		drawCollisionPlane(&planes[i]);
+
+	glColor3fv(SECONDARY_COLOR);
+	drawField(&field);
+
+	drawCollisionData(&collisionData);
+}
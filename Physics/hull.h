@@ -0,0 +1,44 @@
+#ifndef __HULL_H_INCLUDED__
+#define __HULL_H_INCLUDED__
+
+#include <iostream>
+
+#include "precision.h"
+#include "core.h"
+
+#include "body.h"
+#include "fgen.h"
+#include "joints.h"
+#include "world.h"
+#include "collide_fine.h"
+
+#include "graphics.h"
+#include "app.h"
+
+
+// A pile of octagons falling into the box. Each octagon is one
+// CollisionPolygon, or with boxes = true the two crossed boxes whose
+// outline it rounds off, the multi-box way of building the shape.
+class HullApp : public RigidBodyApplication
+{
+protected:
+	static const int PIECE_NUM = 24;
+	static const int PLANE_NUM = 4;
+
+	bool boxes;
+	RigidBody bodies[PIECE_NUM];
+
+	CollisionPolygon polygons[PIECE_NUM];
+	CollisionBox crossBoxes[PIECE_NUM * 2];
+	CollisionPlane planes[PLANE_NUM];
+
+protected:
+	void generateContacts();
+
+public:
+	HullApp(bool boxes = false);
+	void display();
+};
+
+
+#endif
@@ -0,0 +1,179 @@
+#include "island.h"
+#include "contacts.h"
+
+int IslandGraph::find(int node)
+{
+	// path halving
+	while (parent[node] != node)
+	{
+		parent[node] = parent[parent[node]];
+		node = parent[node];
+	}
+	return node;
+}
+
+void IslandGraph::merge(int one, int other)
+{
+	one = find(one);
+	other = find(other);
+	if (one == other)
+		return;
+
+	// the smaller index becomes the root, keeps the numbering stable
+	if (one < other)
+		parent[other] = one;
+	else
+		parent[one] = other;
+}
+
+int IslandGraph::getNode(RigidBody* body) const
+{
+	if (body == NULL)
+		return -1;
+	return bodyTable.find((HashTable::Key)(size_t)body);
+}
+
+void IslandGraph::clear()
+{
+	bodyTable.clear();
+	bodies.clear();
+	parent.clear();
+	island.clear();
+	islandStart.clear();
+	islandBodies.clear();
+	islandAwake.clear();
+}
+
+int IslandGraph::addBody(RigidBody* body)
+{
+	if (body == NULL || !body->isMovable())
+		return -1;
+
+	HashTable::Key key = (HashTable::Key)(size_t)body;
+	int node = bodyTable.find(key);
+	if (node >= 0)
+		return node;
+
+	node = (int)bodies.size();
+	bodyTable.insert(key, node);
+	bodies.push_back(body);
+	parent.push_back(node);
+	return node;
+}
+
+void IslandGraph::addContacts(const Contact *contacts, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		int one = addBody(contacts[i].body[0]);
+		int other = addBody(contacts[i].body[1]);
+		if (one >= 0 && other >= 0)
+			merge(one, other);
+	}
+}
+
+int IslandGraph::build()
+{
+	int nodeNum = (int)bodies.size();
+	island.assign(nodeNum, -1);
+	islandStart.clear();
+	islandAwake.clear();
+
+	// roots are numbered in node order
+	int islandNum = 0;
+	for (int node = 0; node < nodeNum; node++)
+	{
+		int root = find(node);
+		if (island[root] < 0)
+		{
+			island[root] = islandNum++;
+			islandStart.push_back(0);
+			islandAwake.push_back(false);
+		}
+		island[node] = island[root];
+		islandStart[island[node]]++;
+		if (bodies[node]->getIsAwake())
+			islandAwake[island[node]] = true;
+	}
+
+	// counts to offsets, then group the nodes
+	int total = 0;
+	for (int i = 0; i < islandNum; i++)
+	{
+		int count = islandStart[i];
+		islandStart[i] = total;
+		total += count;
+	}
+	islandStart.push_back(total);
+
+	islandBodies.resize(nodeNum);
+	islandFill.assign(islandStart.begin(), islandStart.end() - 1);
+	for (int node = 0; node < nodeNum; node++)
+		islandBodies[islandFill[island[node]]++] = node;
+
+	return islandNum;
+}
+
+int IslandGraph::getIslandCount() const
+{
+	return (int)islandAwake.size();
+}
+
+int IslandGraph::getIsland(RigidBody* body) const
+{
+	int node = getNode(body);
+	return (node < 0) ? -1 : island[node];
+}
+
+int IslandGraph::getContactIsland(const Contact &contact) const
+{
+	int result = getIsland(contact.body[0]);
+	if (result < 0)
+		result = getIsland(contact.body[1]);
+	return result;
+}
+
+bool IslandGraph::isIslandAwake(int island) const
+{
+	return islandAwake[island];
+}
+
+int IslandGraph::getAwakeIslandCount() const
+{
+	int count = 0;
+	for (size_t i = 0; i < islandAwake.size(); i++)
+		if (islandAwake[i])
+			count++;
+	return count;
+}
+
+void IslandGraph::updateSleep()
+{
+	int islandNum = getIslandCount();
+	for (int i = 0; i < islandNum; i++)
+	{
+		bool settled = true;
+		bool awake = false;
+		for (int k = islandStart[i]; k < islandStart[i + 1]; k++)
+		{
+			RigidBody* body = bodies[islandBodies[k]];
+			if (!body->getIsAwake())
+				continue;
+			awake = true;
+			if (!body->getCanSleep() || body->getMotion() >= RigidBody::sleepEpsilon)
+				settled = false;
+		}
+		if (!awake)
+			continue;
+
+		for (int k = islandStart[i]; k < islandStart[i + 1]; k++)
+		{
+			RigidBody* body = bodies[islandBodies[k]];
+			if (settled && body->getIsAwake())
+				body->setAwake(false);
+			else if (!settled && !body->getIsAwake())
+				body->setAwake(true);
+		}
+		islandAwake[i] = !settled;
+	}
+}
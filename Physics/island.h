@@ -0,0 +1,55 @@
+#ifndef __ISLAND_H_INCLUDED__
+#define __ISLAND_H_INCLUDED__
+
+
+#include <vector>
+
+#include "precision.h"
+#include "body.h"
+#include "table.h"
+
+class Contact;
+
+// Groups of bodies connected by contacts, found with union-find. Planes
+// and immovable bodies join nothing, so everything resting on the ground
+// does not become one island. Rebuilt from scratch every step.
+class IslandGraph
+{
+protected:
+	HashTable bodyTable; // body pointer -> node
+	std::vector<RigidBody*> bodies; // node -> body
+	std::vector<int> parent;
+	std::vector<int> island; // node -> island, set by build
+	std::vector<int> islandStart; // island -> first entry in islandBodies
+	std::vector<int> islandBodies; // nodes grouped by island
+	std::vector<int> islandFill; // build scratch, next free entry per island
+	std::vector<bool> islandAwake;
+
+protected:
+	int find(int node);
+	void merge(int one, int other);
+	int getNode(RigidBody* body) const;
+
+public:
+	void clear();
+	// returns the node, -1 for NULL or immovable bodies
+	int addBody(RigidBody* body);
+	void addContacts(const Contact *contacts, int count);
+	// numbers the islands 0..n-1, call after everything is added
+	int build();
+
+	// accessor, valid after build
+	int getIslandCount() const;
+	int getIsland(RigidBody* body) const; // -1 if not in any island
+	int getContactIsland(const Contact &contact) const;
+	bool isIslandAwake(int island) const;
+	int getAwakeIslandCount() const;
+
+	// Sleep decided per island: an island where every body has settled
+	// goes to sleep as a whole, and a moving body wakes its whole island.
+	// Needs World::setIslandSleep(true) so bodies do not sleep alone.
+	void updateSleep();
+};
+
+
+#endif // __ISLAND_H_INCLUDED__
@@ -0,0 +1,183 @@
+#include "jobs.h"
+
+static thread_local int threadIndex = 0;
+
+JobSystem::JobDeque::JobDeque()
+	: top(0), bottom(0)
+{
+	for (int i = 0; i < CAPACITY; i++)
+		jobs[i].store(NULL, std::memory_order_relaxed);
+}
+
+bool JobSystem::JobDeque::push(Job *job)
+{
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY)
+		return false;
+
+	jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+JobSystem::Job* JobSystem::JobDeque::pop()
+{
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	Job *job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last job, race the stealers for it
+		if (!top.compare_exchange_strong(t, t + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = NULL;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::JobDeque::steal()
+{
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return NULL;
+
+	Job *job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1,
+		std::memory_order_seq_cst, std::memory_order_relaxed))
+		return NULL;
+	return job;
+}
+
+JobSystem::JobSystem(int threadCount)
+	: queued(0), running(true)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount <= 0)
+		threadCount = 1;
+
+	for (int i = 0; i < threadCount; i++)
+		deques.push_back(new JobDeque);
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	for (size_t i = 0; i < deques.size(); i++)
+		delete deques[i];
+}
+
+int JobSystem::getThreadCount() const
+{
+	return (int)deques.size();
+}
+
+int JobSystem::getThreadIndex()
+{
+	return threadIndex;
+}
+
+JobSystem::Job* JobSystem::findJob(int index)
+{
+	Job *job = deques[index]->pop();
+	int threadCount = (int)deques.size();
+	for (int i = 1; job == NULL && i < threadCount; i++)
+		job = deques[(index + i) % threadCount]->steal();
+
+	if (job != NULL)
+		queued--;
+	return job;
+}
+
+void JobSystem::run(Job *job)
+{
+	job->function(job->data, job->index);
+	// the job may be gone once remaining reaches zero
+	job->remaining->fetch_sub(1);
+}
+
+void JobSystem::workerLoop(int index)
+{
+	threadIndex = index;
+	while (running)
+	{
+		Job *job = findJob(index);
+		if (job != NULL)
+		{
+			run(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		while (queued.load() <= 0 && running)
+			sleepCondition.wait(lock);
+	}
+}
+
+void JobSystem::parallelFor(int count, JobFunction function, void *data)
+{
+	if (count <= 0)
+		return;
+	if (workers.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			function(data, i);
+		return;
+	}
+
+	std::atomic<int> remaining(count);
+	std::vector<Job> jobs(count);
+	JobDeque *own = deques[threadIndex];
+
+	// pushed backwards, so this thread pops them in index order while
+	// stealers start from the far end
+	for (int i = count - 1; i >= 0; i--)
+	{
+		Job &job = jobs[i];
+		job.function = function;
+		job.data = data;
+		job.index = i;
+		job.remaining = &remaining;
+		if (own->push(&job))
+			queued++;
+		else
+			run(&job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_all();
+
+	while (remaining.load() > 0)
+	{
+		Job *job = findJob(threadIndex);
+		if (job != NULL)
+			run(job);
+		else
+			std::this_thread::yield();
+	}
+}
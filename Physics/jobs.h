@@ -0,0 +1,78 @@
+#ifndef __JOBS_H_INCLUDED__
+#define __JOBS_H_INCLUDED__
+
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Work-stealing job system. Every thread owns a deque: it pushes and pops
+// jobs at the bottom, idle threads steal from the top (Chase-Lev), so
+// handing out work takes no lock. The thread that calls parallelFor owns
+// deque 0 and helps until its jobs are done; jobs may call parallelFor
+// themselves. Idle workers sleep on a condition variable, which is only
+// touched when new jobs are queued.
+//
+// parallelFor is called from one outside thread at a time (the one that
+// steps the world) or from inside jobs.
+class JobSystem
+{
+public:
+	typedef void (*JobFunction)(void *data, int index);
+
+protected:
+	struct Job
+	{
+		JobFunction function;
+		void *data;
+		int index;
+		std::atomic<int> *remaining;
+	};
+
+	class JobDeque
+	{
+	public:
+		static const int CAPACITY = 4096; // power of two
+
+	protected:
+		std::atomic<long long> top;
+		std::atomic<long long> bottom;
+		std::atomic<Job*> jobs[CAPACITY];
+
+	public:
+		JobDeque();
+		bool push(Job *job); // owner only, false when full
+		Job* pop(); // owner only
+		Job* steal();
+	};
+
+	std::vector<JobDeque*> deques; // by thread index
+	std::vector<std::thread> workers;
+	std::atomic<int> queued; // pushed and not yet taken
+	std::atomic<bool> running;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+
+protected:
+	void workerLoop(int index);
+	Job* findJob(int index);
+	void run(Job *job);
+
+public:
+	// threadCount counts the calling thread, 0 uses every hardware thread
+	JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	int getThreadCount() const;
+	// index of the calling thread, 0 outside the workers
+	static int getThreadIndex();
+
+	// runs function(data, i) for every i in [0, count) and returns when
+	// all of them are done
+	void parallelFor(int count, JobFunction function, void *data);
+};
+
+
+#endif // __JOBS_H_INCLUDED__
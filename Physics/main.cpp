@@ -1,18 +1,22 @@
+#ifdef _WIN32
 #include <windows.h>  // for MS Windows
+#endif
 #include <GL/glut.h>  // GLUT, include glu.h and gl.h
 #include <iostream>
-#include <time.h>
 
 #include "graphics.h"
 #include "app.h"
+#include "stepper.h"
 #include "sandBox.h"
 #include "car.h"
-#include "domino.h"
+#include "Domino.h"
 #include "cradle.h"
 #include "pool.h"
 #include "bridge.h"
 #include "curtain.h"
 #include "piston.h"
+#include "hull.h"
+#include "nbody.h"
 
 using namespace std;
 
@@ -24,8 +28,9 @@ const int WINDOW_H = 800;
 
 const double refreshMills = 1;
 
-clock_t t;
 RigidBodyApplication* app;
+JobSystem jobs; // one thread per core, shared by every scene
+PhysicsThread physics; // steps the scene at 60 ticks a second
 
 void display();
 void reshape(GLsizei width, GLsizei height);
@@ -37,6 +42,7 @@ void motion(int x, int y);
 void Timer(int value);
 
 void init();
+void startScene();
 void draw();
 Vector2 screenToWorld(int x, int y);
 
@@ -77,12 +83,28 @@ void init()
 	//glEnable(GL_MULTISAMPLE);
 
 	app = new SandBoxApp;
+	startScene();
+}
+
+static void stepScene(void *data, real duration)
+{
+	static_cast<RigidBodyApplication*>(data)->update(duration);
+}
+
+void startScene()
+{
+	app->setJobSystem(&jobs);
+	physics.start(stepScene, app, app->getWorld().getBodyStore(), &app->getCollisionData());
 }
 
 void display() 
 {
 	glClear(GL_COLOR_BUFFER_BIT);  // Clear the color buffer
+	// the latest tick, not the one running, blended from the one before
+	const BodySnapshot &snapshot = physics.acquire();
+	setDrawSnapshot(&snapshot, physics.getAlpha(snapshot));
 	draw();
+	setDrawSnapshot(NULL);
 
 	glFlush();
 	glutSwapBuffers();  // Swap front and back buffers (of double buffered mode)
@@ -95,7 +117,15 @@ void reshape(GLsizei width, GLsizei height)
 /* Callback handler for normal-key event */
 void keyboard(unsigned char key, int x, int y)
 {
+	physics.lock();
 	app->keyboard(key);
+	physics.unlock();
+
+	// the old scene is deleted, which needs the stepping stopped
+	if ((key < '0' || key > '9') && key != '-')
+		return;
+	physics.stop();
+	delete app;
 
 	switch (key)
 	{
@@ -123,10 +153,20 @@ void keyboard(unsigned char key, int x, int y)
 	case '7':
 		app = new PistonApp;
 		break;
+	case '8':
+		app = new HullApp;
+		break;
+	case '9':
+		app = new HullApp(true);
+		break;
+	case '-':
+		app = new NBodyApp;
+		break;
 
 	default:
 		break;
 	}
+	startScene();
 }
 
 /* Callback handler for special-key event */
@@ -144,28 +184,14 @@ void motion(int x, int y)
 void passiveMotion(int x, int y)
 {
 	Vector2 mouseVector = screenToWorld(x, y);
+	physics.lock();
 	app->passiveMotion(mouseVector);
+	physics.unlock();
 }
 
 /* Called back when timer expired */
 void Timer(int value)
 {
-	real duration = (real)(clock() - t) / CLOCKS_PER_SEC;
-	t = clock();
-	//std::cout << duration << "\n";
-
-	if (0)
-	{
-		duration = 1.0f / 60;
-		cin.ignore();
-	}
-
-	if (duration > 0)
-	{
-		duration = duration * 1.0;
-		app->update(duration);
-	}
-
 	glutPostRedisplay();      // Post re-paint request to activate display()
 	glutTimerFunc(refreshMills, Timer, 0); // next Timer call milliseconds later
 }
@@ -0,0 +1,96 @@
+#include "nbody.h"
+
+NBodyApp::NBodyApp(bool exact) :
+RigidBodyApplication(),
+mutualGravity((real)1e-4, exact ? 0 : (real)0.5, (real)0.02)
+{
+	collisionData.restitution = 0.5;
+	gravity.setOn(false);
+
+	// walls
+	real wallDist = 0.9;
+	planes[0] = CollisionPlane(Vector2::Y, -wallDist);
+	planes[1] = CollisionPlane(-Vector2::Y, -wallDist);
+	planes[2] = CollisionPlane(Vector2::X, -wallDist * 2);
+	planes[3] = CollisionPlane(-Vector2::X, -wallDist * 2);
+
+	real sphereMass = 1;
+	real sphereRadius = 0.004;
+	real sphereMOI = sphereMass * sphereMOIPerMass(sphereRadius);
+
+	// evenly over the disk on a golden angle spiral, each sphere on the
+	// circular orbit around the mass inside its radius
+	real diskRadius = 0.7;
+	real goldenAngle = (real)2.39996322972865332;
+	real totalMass = sphereMass * SPHERE_NUM;
+	for (int i = 0; i < SPHERE_NUM; i++)
+	{
+		real fraction = ((real)i + (real)0.5) / SPHERE_NUM;
+		real radius = diskRadius * real_sqrt(fraction);
+		real angle = goldenAngle * i;
+		Vector2 direction(real_cos(angle), real_sin(angle));
+		real speed = real_sqrt((real)1e-4 * totalMass * fraction / radius);
+
+		sphere_bodies[i] = RigidBody(world.getBodyStore(), direction * radius,
+			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
+		sphere_bodies[i].applyImpulseAtPoint(Vector2(-direction.y, direction.x) * (speed * sphereMass),
+			sphere_bodies[i].getPosition());
+	}
+
+	for (int i = 0; i < SPHERE_NUM; i++)
+		spheres[i] = CollisionSphere(&sphere_bodies[i], sphereRadius);
+
+	// the spheres bounce off the walls, not off each other
+	for (int i = 0; i < SPHERE_NUM; i++)
+		collisionSpace.add(&spheres[i], 2, 1);
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
+	// assign to world
+	for (int i = 0; i < SPHERE_NUM; i++)
+		world.getRigidBodies().push_back(&sphere_bodies[i]);
+
+	World::RigidBodies::iterator i = world.getRigidBodies().begin();
+	for (; i != world.getRigidBodies().end(); i++)
+	{
+		world.getForceRegistry().add((*i), &mutualGravity);
+		world.getForceRegistry().add((*i), &field);
+	}
+}
+
+void NBodyApp::generateContacts()
+{
+	collisionData.reset();
+	collisionSpace.generateContacts(&collisionData);
+}
+
+void NBodyApp::display()
+{
+	glColor3fv(OBJECT_COLOR);
+	for (int i = 0; i < SPHERE_NUM; i++)
+		drawCollisionSphere(&spheres[i]);
+	for (int i = 0; i < PLANE_NUM; i++)
+		drawCollisionPlane(&planes[i]);
+
+	glColor3fv(SECONDARY_COLOR);
+	drawField(&field);
+}
+
+void NBodyApp::keyboard(unsigned char key)
+{
+	switch (key)
+	{
+	case 't':
+		mutualGravity.setOpeningAngle(mutualGravity.getOpeningAngle() > 0 ? 0 : (real)0.5);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void NBodyApp::setJobSystem(JobSystem *jobs)
+{
+	RigidBodyApplication::setJobSystem(jobs);
+	mutualGravity.setJobSystem(jobs);
+}
@@ -0,0 +1,46 @@
+#ifndef __NBODY_H_INCLUDED__
+#define __NBODY_H_INCLUDED__
+
+#include <iostream>
+
+#include "precision.h"
+#include "core.h"
+
+#include "body.h"
+#include "fgen.h"
+#include "world.h"
+#include "collide_fine.h"
+
+#include "graphics.h"
+#include "app.h"
+
+
+// A spinning disk of small spheres held together by their own gravity
+// (MutualGravity). With exact = true the pull is summed over every pair
+// instead of through the quadtree, the reference the bench compares
+// against. 't' switches between the two.
+class NBodyApp : public RigidBodyApplication
+{
+protected:
+	static const int SPHERE_NUM = 2000;
+	static const int PLANE_NUM = 4;
+
+	RigidBody sphere_bodies[SPHERE_NUM];
+
+	CollisionSphere spheres[SPHERE_NUM];
+	CollisionPlane planes[PLANE_NUM];
+
+	MutualGravity mutualGravity;
+
+protected:
+	void generateContacts();
+
+public:
+	NBodyApp(bool exact = false);
+	void display();
+	void keyboard(unsigned char key);
+	void setJobSystem(JobSystem *jobs);
+};
+
+
+#endif
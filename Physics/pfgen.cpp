@@ -1,4 +1,9 @@
 #include "pfgen.h"
+#include "psystem.h"
+
+void ParticleForceGenerator::updateForces(ParticleSystem &system, int begin, int end,
+	real duration)
+{}
 
 void ParticleForceRegistry::add(Particle *particle, ParticleForceGenerator *fg)
 {
@@ -37,6 +42,35 @@ void ParticleGravity::updateForce(Particle *particle, real duration)
 	particle->addForce(gravity * particle->getMass());
 }
 
+// ParticleGravity::updateForce on a lane's worth of particles, one per
+// lane
+template<class Lane>
+static void particleGravityLanes(real *forceX, real *forceY, const real *inverseMass,
+	const Vector2 &gravity)
+{
+	Lane tag = Lane();
+	Lane one = simdSet((real)1.0, tag);
+	Lane inverse = simdLoad(inverseMass, tag);
+	Lane finite = simdGreater(inverse, simdSet((real)0.0, tag));
+	Lane mass = simdDiv(one, simdSelect(finite, inverse, one));
+	Lane fx = simdLoad(forceX, tag);
+	Lane fy = simdLoad(forceY, tag);
+	simdStore(forceX, simdSelect(finite, simdAdd(fx, simdMul(simdSet(gravity.x, tag), mass)), fx));
+	simdStore(forceY, simdSelect(finite, simdAdd(fy, simdMul(simdSet(gravity.y, tag), mass)), fy));
+}
+
+void ParticleGravity::updateForces(ParticleSystem &system, int begin, int end,
+	real duration)
+{
+	int i = begin;
+	for (; i + SIMD_LANES <= end; i += SIMD_LANES)
+		particleGravityLanes<SimdReal>(&system.forceX[i], &system.forceY[i],
+			&system.inverseMass[i], gravity);
+	for (; i < end; i++)
+		particleGravityLanes<real>(&system.forceX[i], &system.forceY[i],
+			&system.inverseMass[i], gravity);
+}
+
 ParticleDrag::ParticleDrag()
 {}
 
@@ -59,6 +93,33 @@ void ParticleDrag::updateForce(Particle *particle, real duration)
 	particle->addForce(force);
 }
 
+// ParticleDrag::updateForce on a lane's worth of particles, as
+// -v * (k1 + k2*|v|), which is the same force without the division
+template<class Lane>
+static void particleDragLanes(real *forceX, real *forceY, const real *velocityX,
+	const real *velocityY, real k1, real k2)
+{
+	Lane tag = Lane();
+	Lane vx = simdLoad(velocityX, tag);
+	Lane vy = simdLoad(velocityY, tag);
+	Lane speed = simdSqrt(simdAdd(simdMul(vx, vx), simdMul(vy, vy)));
+	Lane coefficient = simdAdd(simdSet(k1, tag), simdMul(simdSet(k2, tag), speed));
+	simdStore(forceX, simdSub(simdLoad(forceX, tag), simdMul(vx, coefficient)));
+	simdStore(forceY, simdSub(simdLoad(forceY, tag), simdMul(vy, coefficient)));
+}
+
+void ParticleDrag::updateForces(ParticleSystem &system, int begin, int end,
+	real duration)
+{
+	int i = begin;
+	for (; i + SIMD_LANES <= end; i += SIMD_LANES)
+		particleDragLanes<SimdReal>(&system.forceX[i], &system.forceY[i],
+			&system.velocityX[i], &system.velocityY[i], k1, k2);
+	for (; i < end; i++)
+		particleDragLanes<real>(&system.forceX[i], &system.forceY[i],
+			&system.velocityX[i], &system.velocityY[i], k1, k2);
+}
+
 ParticleField::ParticleField()
 {}
 
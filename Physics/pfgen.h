@@ -7,10 +7,17 @@
 #include "core.h"
 #include "particle.h"
 
+class ParticleSystem;
+
 class ParticleForceGenerator
 {
 public:
 	virtual void updateForce(Particle *particle, real duration) = 0;
+	// the force on the particles [begin, end) of a ParticleSystem; only
+	// generators with a kernel over its columns override it, the default
+	// does nothing
+	virtual void updateForces(ParticleSystem &system, int begin, int end,
+		real duration);
 };
 
 class ParticleForceRegistry
@@ -43,6 +50,9 @@ public:
 	ParticleGravity(const Vector2& g);
 	void setGravity(const Vector2& gravity);
 	virtual void updateForce(Particle *particle, real duration);
+	// SIMD_LANES particles at a time (simd.h)
+	virtual void updateForces(ParticleSystem &system, int begin, int end,
+		real duration);
 };
 
 // drag
@@ -56,6 +66,9 @@ public:
 	ParticleDrag();
 	ParticleDrag(real k1, real k2);
 	virtual void updateForce(Particle *particle, real duration);
+	// SIMD_LANES particles at a time (simd.h)
+	virtual void updateForces(ParticleSystem &system, int begin, int end,
+		real duration);
 };
 
 // force field
@@ -4,6 +4,7 @@ PistonApp::PistonApp() :
 RigidBodyApplication()
 {
 	collisionData.friction = 10;
+	isPistonOn = false;
 
 	real sphereRadius = 0.2;
 
@@ -29,7 +30,7 @@ RigidBodyApplication()
 	Vector2 boxStackGap(boxHalfSize.x * 2, 0);
 	for (int i = 0; i < BOX_NUM; i++)
 	{
-		box_bodies[i] = RigidBody(boxStackPosition + boxStackGap * i,
+		box_bodies[i] = RigidBody(world.getBodyStore(), boxStackPosition + boxStackGap * i,
 			Vector2(1, 0.0), 1.0f / boxMass, 1.0f / boxMOI);
 	}
 
@@ -37,7 +38,7 @@ RigidBodyApplication()
 	Vector2 sphereStackGap(0, 0.5);
 	for (int i = 0; i < SPHERE_NUM; i++)
 	{
-		sphere_bodies[i] = RigidBody(sphereStackPosition + sphereStackGap * i,
+		sphere_bodies[i] = RigidBody(world.getBodyStore(), sphereStackPosition + sphereStackGap * i,
 			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
 	}
 
@@ -1,8 +1,6 @@
 #ifndef __PISTON_H_INCLUDED__
 #define __PISTON_H_INCLUDED__
 
-#include <windows.h>
-#include <GL/glut.h>
 #include <iostream>
 
 #include "precision.h"
@@ -38,15 +38,24 @@ RigidBodyApplication()
 	position[14] = Vector2(position[10].x + dist, position[10].y - sphereRadius);
 	position[15] = Vector2(position[10].x + dist, position[10].y + sphereRadius);
 
+	// a hard shot moves a ball more than its width a step, so the balls
+	// are bullets and one substep does instead of ITERATION
 	for (int i = 0; i < SPHERE_NUM; i++)
 	{
-		sphere_bodies[i] = RigidBody(position[i],
+		sphere_bodies[i] = RigidBody(world.getBodyStore(), position[i],
 			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
+		sphere_bodies[i].setBullet();
 	}
+	setSubsteps(1);
 
 	for (int i = 0; i < SPHERE_NUM; i++)
 		spheres[i] = CollisionSphere(&sphere_bodies[i], sphereRadius);
 
+	for (int i = 0; i < SPHERE_NUM; i++)
+		collisionSpace.add(&spheres[i]);
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
 
 	// assign to world
 	for (int i = 0; i < SPHERE_NUM; i++)
@@ -64,16 +73,7 @@ RigidBodyApplication()
 void PoolApp::generateContacts()
 {
 	collisionData.reset();
-
-	for (int i = 0; i < SPHERE_NUM; i++)
-		for (int j = i + 1; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndSphere(spheres[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < PLANE_NUM; i++)
-	{
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndHalfSpace(spheres[j], planes[i], &collisionData);
-	}
+	collisionSpace.generateContacts(&collisionData);
 }
 
 void PoolApp::display()
@@ -1,8 +1,6 @@
 #ifndef __POOL_H_INCLUDED__
 #define __POOL_H_INCLUDED__
 
-#include <windows.h>
-#include <GL/glut.h>
 #include <iostream>
 
 #include "precision.h"
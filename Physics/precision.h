@@ -3,8 +3,11 @@
 
 
 #include <math.h>
+#include <float.h>
 
-#if 0
+// real is double unless PHYSICS_SINGLE_PRECISION is defined (the
+// PHYSICS_SINGLE_PRECISION CMake option, or the physics_float targets)
+#ifdef PHYSICS_SINGLE_PRECISION
 	typedef float real;
 	const real PI = (real)3.14159265358;
 	#define REAL_MAX FLT_MAX
@@ -13,6 +16,7 @@
 	#define real_abs fabsf
 	#define real_sin sinf
 	#define real_cos cosf
+	#define real_atan2 atan2f
 	#define real_exp expf
 	#define real_fmax fmaxf
 	#define real_fmin fminf
@@ -25,6 +29,7 @@
 	#define real_abs fabs
 	#define real_sin sin
 	#define real_cos cos
+	#define real_atan2 atan2
 	#define real_exp exp
 	#define real_fmax fmax
 	#define real_fmin fmin
@@ -0,0 +1,178 @@
+#include "profile.h"
+
+void ProfileFrame::clear()
+{
+	for (int i = 0; i < PROFILE_PHASE_NUM; i++)
+		phaseTime[i] = 0;
+	contacts = 0;
+	positionIterationUsed = 0;
+	velocityIterationUsed = 0;
+}
+
+long long ProfileFrame::totalTime() const
+{
+	long long total = 0;
+	for (int i = 0; i < PROFILE_PHASE_NUM; i++)
+		total += phaseTime[i];
+	return total;
+}
+
+Profiler::Profiler()
+{
+	clear();
+}
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+const char* Profiler::getPhaseName(ProfilePhase phase)
+{
+	static const char* names[PROFILE_PHASE_NUM] =
+	{
+		"updateForces",
+		"integrate",
+		"worldContacts",
+		"appContacts",
+		"prepareContacts",
+		"adjustPositions",
+		"adjustVelocities"
+	};
+	return names[phase];
+}
+
+bool Profiler::isOwner() const
+{
+	return std::this_thread::get_id() == owner;
+}
+
+void Profiler::beginFrame()
+{
+	if (frameDepth == 0)
+	{
+		owner = std::this_thread::get_id();
+		current.clear();
+	}
+	else if (!isOwner())
+		return;
+	frameDepth++;
+}
+
+void Profiler::endFrame()
+{
+	if (frameDepth == 0 || !isOwner() || --frameDepth > 0)
+		return;
+
+	history[head] = current;
+	head = (head + 1) % HISTORY_SIZE;
+	if (count < HISTORY_SIZE)
+		count++;
+}
+
+void Profiler::addTime(ProfilePhase phase, long long nanoseconds)
+{
+	if (!isOwner())
+		return;
+	current.phaseTime[phase] += nanoseconds;
+}
+
+void Profiler::addContacts(int contacts)
+{
+	if (!isOwner())
+		return;
+	current.contacts += contacts;
+}
+
+void Profiler::addIterations(int positionIterationUsed, int velocityIterationUsed)
+{
+	if (!isOwner())
+		return;
+	current.positionIterationUsed += positionIterationUsed;
+	current.velocityIterationUsed += velocityIterationUsed;
+}
+
+int Profiler::getFrameCount() const
+{
+	return count;
+}
+
+const ProfileFrame& Profiler::getFrame(int index) const
+{
+	int i = (head - 1 - index + HISTORY_SIZE) % HISTORY_SIZE;
+	return history[i];
+}
+
+ProfileFrame Profiler::getAverage() const
+{
+	ProfileFrame average;
+	average.clear();
+	if (count == 0)
+		return average;
+
+	for (int i = 0; i < count; i++)
+	{
+		const ProfileFrame& frame = getFrame(i);
+		for (int p = 0; p < PROFILE_PHASE_NUM; p++)
+			average.phaseTime[p] += frame.phaseTime[p];
+		average.contacts += frame.contacts;
+		average.positionIterationUsed += frame.positionIterationUsed;
+		average.velocityIterationUsed += frame.velocityIterationUsed;
+	}
+
+	for (int p = 0; p < PROFILE_PHASE_NUM; p++)
+		average.phaseTime[p] /= count;
+	average.contacts /= count;
+	average.positionIterationUsed /= count;
+	average.velocityIterationUsed /= count;
+	return average;
+}
+
+void Profiler::clear()
+{
+	head = 0;
+	count = 0;
+	frameDepth = 0;
+	owner = std::thread::id();
+	current.clear();
+}
+
+void Profiler::dump(FILE *file) const
+{
+	for (int p = 0; p < PROFILE_PHASE_NUM; p++)
+		fprintf(file, "%s,", getPhaseName((ProfilePhase)p));
+	fprintf(file, "contacts,positionIterationUsed,velocityIterationUsed\n");
+
+	for (int i = count - 1; i >= 0; i--)
+	{
+		const ProfileFrame& frame = getFrame(i);
+		for (int p = 0; p < PROFILE_PHASE_NUM; p++)
+			fprintf(file, "%lld,", frame.phaseTime[p]);
+		fprintf(file, "%d,%d,%d\n", frame.contacts,
+			frame.positionIterationUsed, frame.velocityIterationUsed);
+	}
+}
+
+ScopedTimer::ScopedTimer(ProfilePhase phase)
+{
+	this->phase = phase;
+	start = std::chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	Profiler::get().addTime(phase,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+ScopedFrame::ScopedFrame()
+{
+	Profiler::get().beginFrame();
+}
+
+ScopedFrame::~ScopedFrame()
+{
+	Profiler::get().endFrame();
+}
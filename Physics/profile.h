@@ -0,0 +1,111 @@
+#ifndef __PROFILE_H_INCLUDED__
+#define __PROFILE_H_INCLUDED__
+
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+// Per-phase step timing. The timers are only compiled in when
+// PHYSICS_PROFILE is defined; otherwise the PROFILE_* macros expand to
+// nothing and the history stays empty.
+//
+// Only the thread that began the outermost frame records; timers and
+// counters from job system workers are dropped, so with threads the
+// resolver phases show the share run on the stepping thread.
+
+enum ProfilePhase
+{
+	PROFILE_UPDATE_FORCES,
+	PROFILE_INTEGRATE,
+	PROFILE_WORLD_CONTACTS,
+	PROFILE_APP_CONTACTS,
+	PROFILE_PREPARE_CONTACTS,
+	PROFILE_ADJUST_POSITIONS,
+	PROFILE_ADJUST_VELOCITIES,
+	PROFILE_PHASE_NUM
+};
+
+struct ProfileFrame
+{
+	long long phaseTime[PROFILE_PHASE_NUM]; // nanoseconds
+	int contacts;
+	int positionIterationUsed;
+	int velocityIterationUsed;
+
+	void clear();
+	long long totalTime() const;
+};
+
+class Profiler
+{
+public:
+	static const int HISTORY_SIZE = 256;
+
+protected:
+	ProfileFrame history[HISTORY_SIZE]; // ring buffer of finished frames
+	int head; // next slot to write
+	int count;
+	ProfileFrame current;
+	int frameDepth;
+	std::thread::id owner; // thread of the outermost beginFrame
+
+protected:
+	bool isOwner() const;
+
+public:
+	Profiler();
+	static Profiler& get();
+	static const char* getPhaseName(ProfilePhase phase);
+
+	// frames may nest, only the outermost begin/end pair commits
+	void beginFrame();
+	void endFrame();
+
+	void addTime(ProfilePhase phase, long long nanoseconds);
+	void addContacts(int contacts);
+	void addIterations(int positionIterationUsed, int velocityIterationUsed);
+
+	// accessor, index 0 is the most recent frame
+	int getFrameCount() const;
+	const ProfileFrame& getFrame(int index) const;
+	ProfileFrame getAverage() const;
+
+	void clear();
+	void dump(FILE *file) const; // one CSV row per frame, oldest first
+};
+
+class ScopedTimer
+{
+protected:
+	ProfilePhase phase;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	ScopedTimer(ProfilePhase phase);
+	~ScopedTimer();
+};
+
+class ScopedFrame
+{
+public:
+	ScopedFrame();
+	~ScopedFrame();
+};
+
+#ifdef PHYSICS_PROFILE
+	#define PROFILE_CONCAT_(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+	#define PROFILE_SCOPE(phase) ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(phase)
+	#define PROFILE_FRAME() ScopedFrame PROFILE_CONCAT(profileFrame, __LINE__)
+	#define PROFILE_CONTACTS(n) Profiler::get().addContacts(n)
+	#define PROFILE_ITERATIONS(p, v) Profiler::get().addIterations(p, v)
+#else
+	#define PROFILE_SCOPE(phase)
+	#define PROFILE_FRAME()
+	#define PROFILE_CONTACTS(n)
+	#define PROFILE_ITERATIONS(p, v)
+#endif
+
+
+#endif // __PROFILE_H_INCLUDED__
@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "psystem.h"
+
+ParticleSystem::ParticleSystem(real damping)
+{
+	this->damping = damping;
+	jobs = NULL;
+	stepDuration = 0;
+}
+
+int ParticleSystem::add(const Vector2 &position, real inverseMass)
+{
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	velocityX.push_back(0);
+	velocityY.push_back(0);
+	forceX.push_back(0);
+	forceY.push_back(0);
+	this->inverseMass.push_back(inverseMass);
+	return (int)positionX.size() - 1;
+}
+
+void ParticleSystem::reserve(int count)
+{
+	positionX.reserve(count);
+	positionY.reserve(count);
+	velocityX.reserve(count);
+	velocityY.reserve(count);
+	forceX.reserve(count);
+	forceY.reserve(count);
+	inverseMass.reserve(count);
+}
+
+void ParticleSystem::clear()
+{
+	positionX.clear();
+	positionY.clear();
+	velocityX.clear();
+	velocityY.clear();
+	forceX.clear();
+	forceY.clear();
+	inverseMass.clear();
+}
+
+int ParticleSystem::size() const
+{
+	return (int)positionX.size();
+}
+
+Vector2 ParticleSystem::getPosition(int index) const
+{
+	return Vector2(positionX[index], positionY[index]);
+}
+
+Vector2 ParticleSystem::getVelocity(int index) const
+{
+	return Vector2(velocityX[index], velocityY[index]);
+}
+
+real ParticleSystem::getDamping() const
+{
+	return damping;
+}
+
+void ParticleSystem::setDamping(real damping)
+{
+	this->damping = damping;
+}
+
+void ParticleSystem::setJobSystem(JobSystem *jobs)
+{
+	this->jobs = jobs;
+}
+
+void ParticleSystem::addForce(int index, const Vector2 &force)
+{
+	forceX[index] += force.x;
+	forceY[index] += force.y;
+}
+
+// v = v0 + p / m
+void ParticleSystem::applyImpulse(int index, const Vector2 &impulse)
+{
+	velocityX[index] += impulse.x * inverseMass[index];
+	velocityY[index] += impulse.y * inverseMass[index];
+}
+
+void ParticleSystem::addForceGenerator(ParticleForceGenerator *fg)
+{
+	generators.push_back(fg);
+}
+
+void ParticleSystem::removeForceGenerator(ParticleForceGenerator *fg)
+{
+	generators.erase(std::remove(generators.begin(), generators.end(), fg),
+		generators.end());
+}
+
+// Particle::integrate on the particles at the pointers, one per lane
+template<class Lane>
+static void integrateLanes(real *px, real *py, real *vx, real *vy,
+	real *fx, real *fy, const real *inverseMass, real duration, real dampingFactor)
+{
+	Lane tag = Lane();
+	Lane dt = simdSet(duration, tag);
+	Lane halfDtSquare = simdSet(duration * duration / 2, tag);
+	Lane damp = simdSet(dampingFactor, tag);
+	Lane zero = simdSet((real)0.0, tag);
+
+	// a = f / m
+	Lane inverse = simdLoad(inverseMass, tag);
+	Lane accX = simdMul(simdLoad(fx, tag), inverse);
+	Lane accY = simdMul(simdLoad(fy, tag), inverse);
+
+	// v = (v + a*t) * d^t
+	Lane velX = simdMul(simdAdd(simdLoad(vx, tag), simdMul(accX, dt)), damp);
+	Lane velY = simdMul(simdAdd(simdLoad(vy, tag), simdMul(accY, dt)), damp);
+
+	// p = p + v*t + 1/2 * a*t^2
+	simdStore(px, simdAdd(simdAdd(simdLoad(px, tag), simdMul(velX, dt)), simdMul(accX, halfDtSquare)));
+	simdStore(py, simdAdd(simdAdd(simdLoad(py, tag), simdMul(velY, dt)), simdMul(accY, halfDtSquare)));
+	simdStore(vx, velX);
+	simdStore(vy, velY);
+	simdStore(fx, zero);
+	simdStore(fy, zero);
+}
+
+void ParticleSystem::integrate(int begin, int end, real duration)
+{
+	real dampingFactor = real_pow(damping, duration);
+	int i = begin;
+	for (; i + SIMD_LANES <= end; i += SIMD_LANES)
+		integrateLanes<SimdReal>(&positionX[i], &positionY[i], &velocityX[i], &velocityY[i],
+			&forceX[i], &forceY[i], &inverseMass[i], duration, dampingFactor);
+	for (; i < end; i++)
+		integrateLanes<real>(&positionX[i], &positionY[i], &velocityX[i], &velocityY[i],
+			&forceX[i], &forceY[i], &inverseMass[i], duration, dampingFactor);
+}
+
+void ParticleSystem::stepChunk(void *data, int chunk)
+{
+	ParticleSystem *system = (ParticleSystem*)data;
+	int begin = chunk * CHUNK;
+	int end = begin + CHUNK;
+	if (end > system->size())
+		end = system->size();
+
+	for (size_t g = 0; g < system->generators.size(); g++)
+		system->generators[g]->updateForces(*system, begin, end, system->stepDuration);
+	system->integrate(begin, end, system->stepDuration);
+}
+
+void ParticleSystem::runPhysics(real duration)
+{
+	stepDuration = duration;
+	int chunks = (size() + CHUNK - 1) / CHUNK;
+	if (jobs != NULL)
+		jobs->parallelFor(chunks, stepChunk, this);
+	else
+		for (int c = 0; c < chunks; c++)
+			stepChunk(this, c);
+}
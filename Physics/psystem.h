@@ -0,0 +1,76 @@
+#ifndef __PSYSTEM_H_INCLUDED__
+#define __PSYSTEM_H_INCLUDED__
+
+
+#include <vector>
+
+#include "precision.h"
+#include "core.h"
+#include "simd.h"
+#include "pfgen.h"
+#include "jobs.h"
+
+// Particles in bulk, for counts where one Particle object each is too
+// slow. The state is in aligned structure-of-arrays columns, and the
+// particles share one damping, raised to the step once. Force generators
+// act on the whole system through ParticleForceGenerator::updateForces;
+// ParticleGravity and ParticleDrag have kernels for it, the others leave
+// the system alone. There are no contacts.
+//
+// runPhysics goes over the particles in CHUNK sized runs, applying every
+// generator and then integrating each run before the next, so a run's
+// columns are read from cache rather than memory after the first pass.
+// The runs go out as jobs when a JobSystem is set.
+class ParticleSystem
+{
+public:
+	static const int CHUNK = 4096;
+	typedef std::vector<real, SimdAllocator<real> > Column;
+
+	// by particle
+	Column positionX, positionY;
+	Column velocityX, velocityY;
+	Column forceX, forceY;
+	Column inverseMass;
+
+protected:
+	real damping; // 0 to 1
+	std::vector<ParticleForceGenerator*> generators;
+	JobSystem *jobs;
+
+	real stepDuration; // of the runPhysics in progress
+
+protected:
+	static void stepChunk(void *data, int chunk);
+
+public:
+	ParticleSystem(real damping = (real)0.99);
+
+	// returns the new particle's index
+	int add(const Vector2 &position, real inverseMass);
+	void reserve(int count);
+	void clear(); // particles only, the generators stay
+
+	// accessor
+	int size() const;
+	Vector2 getPosition(int index) const;
+	Vector2 getVelocity(int index) const;
+	real getDamping() const;
+	void setDamping(real damping);
+	void setJobSystem(JobSystem *jobs); // NULL for single threaded
+
+	void addForce(int index, const Vector2 &force);
+	void applyImpulse(int index, const Vector2 &impulse);
+
+	void addForceGenerator(ParticleForceGenerator *fg);
+	void removeForceGenerator(ParticleForceGenerator *fg);
+
+	// Particle::integrate on the particles [begin, end), SIMD_LANES at a
+	// time (simd.h), and clears their forces
+	void integrate(int begin, int end, real duration);
+	// the generators' forces, then integrate
+	void runPhysics(real duration);
+};
+
+
+#endif // __PSYSTEM_H_INCLUDED__
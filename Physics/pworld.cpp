@@ -28,6 +28,11 @@ ParticleForceRegistry& ParticleWorld::getForceRegistry()
 	return registry;
 }
 
+ParticleSystem& ParticleWorld::getParticleSystem()
+{
+	return system;
+}
+
 void ParticleWorld::startFrame()
 {
 	Particles::iterator i = particles.begin();
@@ -70,4 +75,6 @@ void ParticleWorld::runPhysics(real duration)
 	if (calculateIterations)
 		resolver.setIterations(usedContacts * 2);
 	resolver.resolveContacts(contacts, usedContacts, duration);
+
+	system.runPhysics(duration);
 }
\ No newline at end of file
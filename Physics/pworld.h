@@ -8,6 +8,7 @@
 #include "particle.h"
 #include "pfgen.h"
 #include "pcontacts.h"
+#include "psystem.h"
 
 
 class ParticleWorld
@@ -20,6 +21,7 @@ protected:
 	Particles particles;
 	ContactGenerators contactGenerators;
 	ParticleForceRegistry registry;
+	ParticleSystem system; // bulk particles, stepped after the others
 	ParticleContactResolver resolver;
 	ParticleContact *contacts;
 	int maxContacts;
@@ -34,6 +36,7 @@ public:
 	Particles& getParticles();
 	ContactGenerators& getContactGenerators();
 	ParticleForceRegistry& getForceRegistry();
+	ParticleSystem& getParticleSystem();
 
 	void startFrame();
 	int generateContacts();
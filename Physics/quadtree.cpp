@@ -0,0 +1,193 @@
+#include "quadtree.h"
+
+// moves the indices in order[begin, end) whose coordinate is below split
+// to the front and returns where the rest start
+static int partitionPoints(int *order, int begin, int end,
+	const real *coordinate, real split)
+{
+	int low = begin, high = end - 1;
+	while (true)
+	{
+		while (low <= high && coordinate[order[low]] < split)
+			low++;
+		while (low <= high && coordinate[order[high]] >= split)
+			high--;
+		if (low > high)
+			return low;
+
+		int swapped = order[low];
+		order[low] = order[high];
+		order[high] = swapped;
+	}
+}
+
+void BarnesHutTree::build(const real *x, const real *y, const real *mass, int count)
+{
+	nodes.clear();
+	order.resize(count);
+	pointX.assign(x, x + count);
+	pointY.assign(y, y + count);
+	pointMass.assign(mass, mass + count);
+	if (count == 0)
+		return;
+
+	real minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+	for (int i = 0; i < count; i++)
+	{
+		order[i] = i;
+		if (x[i] < minX) minX = x[i];
+		if (x[i] > maxX) maxX = x[i];
+		if (y[i] < minY) minY = y[i];
+		if (y[i] > maxY) maxY = y[i];
+	}
+
+	// a square cell around every point
+	real halfSize = (maxX - minX > maxY - minY ? maxX - minX : maxY - minY) / 2;
+	if (halfSize <= 0)
+		halfSize = 1;
+	buildNode(0, count, (minX + maxX) / 2, (minY + maxY) / 2, halfSize, 0);
+
+	// the copies in leaf order, so a leaf reads its points in a row
+	std::vector<real> sortedX(count), sortedY(count), sortedMass(count);
+	for (int k = 0; k < count; k++)
+	{
+		sortedX[k] = pointX[order[k]];
+		sortedY[k] = pointY[order[k]];
+		sortedMass[k] = pointMass[order[k]];
+	}
+	pointX.swap(sortedX);
+	pointY.swap(sortedY);
+	pointMass.swap(sortedMass);
+}
+
+// builds the subtree of the points order[begin, end) in the given cell;
+// the points are still in input order here
+int BarnesHutTree::buildNode(int begin, int end, real centerX, real centerY,
+	real halfSize, int depth)
+{
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+
+	Node node;
+	node.centerX = centerX;
+	node.centerY = centerY;
+	node.halfSize = halfSize;
+	node.begin = begin;
+	node.end = end;
+	node.leaf = (end - begin <= LEAF_SIZE || depth == MAX_DEPTH);
+
+	real mass = 0, momentX = 0, momentY = 0;
+	if (node.leaf)
+	{
+		for (int k = begin; k < end; k++)
+		{
+			int i = order[k];
+			mass += pointMass[i];
+			momentX += pointMass[i] * pointX[i];
+			momentY += pointMass[i] * pointY[i];
+		}
+	}
+	else
+	{
+		// quadrants by y then x: low-left, low-right, high-left, high-right
+		int *points = &order[0];
+		int middle = partitionPoints(points, begin, end, &pointY[0], centerY);
+		int bounds[5] = { begin,
+			partitionPoints(points, begin, middle, &pointX[0], centerX),
+			middle,
+			partitionPoints(points, middle, end, &pointX[0], centerX),
+			end };
+
+		real quarter = halfSize / 2;
+		for (int q = 0; q < 4; q++)
+		{
+			if (bounds[q] == bounds[q + 1])
+				continue;
+
+			real childX = centerX + ((q & 1) ? quarter : -quarter);
+			real childY = centerY + ((q & 2) ? quarter : -quarter);
+			int child = buildNode(bounds[q], bounds[q + 1], childX, childY,
+				quarter, depth + 1);
+			mass += nodes[child].mass;
+			momentX += nodes[child].mass * nodes[child].massX;
+			momentY += nodes[child].mass * nodes[child].massY;
+		}
+	}
+
+	node.mass = mass;
+	node.massX = mass > 0 ? momentX / mass : centerX;
+	node.massY = mass > 0 ? momentY / mass : centerY;
+	node.next = (int)nodes.size();
+	nodes[index] = node;
+	return index;
+}
+
+void BarnesHutTree::field(real x, real y, int skip, real theta, real softening,
+	real &fieldX, real &fieldY) const
+{
+	real thetaSquare = theta * theta;
+	real softeningSquare = softening * softening;
+	real sumX = 0, sumY = 0;
+
+	int n = 0;
+	int count = (int)nodes.size();
+	while (n < count)
+	{
+		const Node &node = nodes[n];
+		if (node.mass == 0)
+		{
+			n = node.next;
+			continue;
+		}
+
+		if (!node.leaf)
+		{
+			real dx = node.massX - x;
+			real dy = node.massY - y;
+			real distanceSquare = dx * dx + dy * dy;
+			real size = 2 * node.halfSize;
+
+			// open the cells that look large and the one holding the point
+			bool inside = real_abs(x - node.centerX) <= node.halfSize &&
+				real_abs(y - node.centerY) <= node.halfSize;
+			if (inside || size * size >= thetaSquare * distanceSquare)
+			{
+				n++;
+				continue;
+			}
+
+			real inverse = 1 / (distanceSquare + softeningSquare);
+			real scale = node.mass * inverse * real_sqrt(inverse);
+			sumX += scale * dx;
+			sumY += scale * dy;
+			n = node.next;
+			continue;
+		}
+
+		for (int k = node.begin; k < node.end; k++)
+		{
+			if (order[k] == skip)
+				continue;
+
+			real dx = pointX[k] - x;
+			real dy = pointY[k] - y;
+			real distanceSquare = dx * dx + dy * dy + softeningSquare;
+			if (distanceSquare == 0)
+				continue;
+
+			real inverse = 1 / distanceSquare;
+			real scale = pointMass[k] * inverse * real_sqrt(inverse);
+			sumX += scale * dx;
+			sumY += scale * dy;
+		}
+		n = node.next;
+	}
+
+	fieldX = sumX;
+	fieldY = sumY;
+}
+
+int BarnesHutTree::getNodeCount() const
+{
+	return (int)nodes.size();
+}
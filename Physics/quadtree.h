@@ -0,0 +1,63 @@
+#ifndef __QUADTREE_H_INCLUDED__
+#define __QUADTREE_H_INCLUDED__
+
+
+#include <vector>
+
+#include "precision.h"
+
+// Barnes-Hut quadtree over point masses, built from scratch each step.
+// Every node keeps the total mass and center of mass of its points; a
+// node that looks small from the query point, size / distance < theta,
+// stands in for all of them, so the field at one point costs O(log n)
+// instead of O(n). theta 0 opens every node and gives the direct sum.
+//
+// The nodes are stored depth first, each followed by its children, and
+// know the node after their subtree, so a query walks the array without
+// a stack. Leaves hold up to LEAF_SIZE points, which are summed
+// directly; build reorders copies of the points leaf by leaf.
+//
+// After build, field may be called from several threads at once.
+class BarnesHutTree
+{
+public:
+	static const int LEAF_SIZE = 8;
+	static const int MAX_DEPTH = 32; // coincident points share a leaf
+
+protected:
+	struct Node
+	{
+		real centerX, centerY; // of the square cell
+		real halfSize;
+		real massX, massY; // center of mass
+		real mass;
+		int begin, end; // points of the subtree, in leaf order
+		int next; // the node after this subtree
+		bool leaf; // otherwise the children follow
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> order; // leaf order -> point index
+	std::vector<real> pointX, pointY, pointMass; // in leaf order
+
+protected:
+	int buildNode(int begin, int end, real centerX, real centerY,
+		real halfSize, int depth);
+
+public:
+	// mass 0 points are kept but pull nothing
+	void build(const real *x, const real *y, const real *mass, int count);
+
+	// the sum over the points j other than skip of
+	//     mass_j * (p_j - p) / (|p_j - p|^2 + softening^2)^(3/2)
+	// which times G is the acceleration at p; coincident points are
+	// skipped when softening is 0
+	void field(real x, real y, int skip, real theta, real softening,
+		real &fieldX, real &fieldY) const;
+
+	// accessor
+	int getNodeCount() const;
+};
+
+
+#endif // __QUADTREE_H_INCLUDED__
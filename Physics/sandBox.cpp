@@ -26,13 +26,13 @@ RigidBodyApplication()
 
 	for (int i = 0; i < SPHERE_NUM; i++)
 	{
-		sphere_bodies[i] = RigidBody(sphereStackPosition + sphereStackGap * i,
+		sphere_bodies[i] = RigidBody(world.getBodyStore(), sphereStackPosition + sphereStackGap * i,
 			Vector2::X, 1.0f / sphereMass, 1.0f / sphereMOI);
 	}
 
 	for (int i = 0; i < BOX_NUM; i++)
 	{
-		box_bodies[i] = RigidBody(boxStackPosition + boxStackGap * i,
+		box_bodies[i] = RigidBody(world.getBodyStore(), boxStackPosition + boxStackGap * i,
 			Vector2(1, 0.0), 1.0f / boxMass, 1.0f / boxMOI);
 	}
 
@@ -42,6 +42,13 @@ RigidBodyApplication()
 	for (int i = 0; i < BOX_NUM; i++)
 		boxes[i] = CollisionBox(&box_bodies[i], boxHalfSize);
 
+	for (int i = 0; i < SPHERE_NUM; i++)
+		collisionSpace.add(&spheres[i]);
+	for (int i = 0; i < BOX_NUM; i++)
+		collisionSpace.add(&boxes[i]);
+	for (int i = 0; i < PLANE_NUM; i++)
+		collisionSpace.addPlane(&planes[i]);
+
 	// joints
 	joints[0] = Joint(&sphere_bodies[0], Vector2(0, 0.0),
 		&box_bodies[0], Vector2(-0.3, -0.1), 0);
@@ -71,26 +78,7 @@ RigidBodyApplication()
 void SandBoxApp::generateContacts()
 {
 	collisionData.reset();
-
-	for (int i = 0; i < SPHERE_NUM; i++)
-		for (int j = i + 1; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndSphere(spheres[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = i + 1; j < BOX_NUM; j++)
-			CollisionDetector::boxAndBox2(boxes[i], boxes[j], &collisionData);
-
-	for (int i = 0; i < BOX_NUM; i++)
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::boxAndSphere(boxes[i], spheres[j], &collisionData);
-
-	for (int i = 0; i < PLANE_NUM; i++)
-	{
-		for (int j = 0; j < SPHERE_NUM; j++)
-			CollisionDetector::sphereAndHalfSpace(spheres[j], planes[i], &collisionData);
-		for (int j = 0; j < BOX_NUM; j++)
-			CollisionDetector::boxAndHalfSpace(boxes[j], planes[i], &collisionData);
-	}
+	collisionSpace.generateContacts(&collisionData);
 }
 
 void SandBoxApp::display()
@@ -0,0 +1,218 @@
+#ifndef __SIMD_H_INCLUDED__
+#define __SIMD_H_INCLUDED__
+
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+
+#include "precision.h"
+
+// Lanes of reals for the batch kernels. SimdReal holds SIMD_LANES reals:
+// four doubles or eight floats with AVX, two doubles or four floats with
+// SSE2, one (plain real) otherwise. Every
+// operation is also defined on real and bool, so a kernel written as a
+// template over the lane type runs the tail of a batch, or the whole of
+// it on other targets, through the same code.
+//
+// Comparisons give a mask, SimdMask for lanes and bool for real, to be
+// combined with simdAnd/simdOr and consumed by simdSelect.
+//
+// Lane arguments that only pick the overload are tags, their value is
+// unused.
+
+#if defined(__AVX__) && !defined(PHYSICS_NO_SIMD)
+	#include <immintrin.h>
+	#ifdef PHYSICS_SINGLE_PRECISION
+		#define SIMD_LANES 8
+		#define SIMD_OP(op) _mm256_##op##_ps
+		typedef __m256 SimdReal;
+	#else
+		#define SIMD_LANES 4
+		#define SIMD_OP(op) _mm256_##op##_pd
+		typedef __m256d SimdReal;
+	#endif
+	#define SIMD_AVX
+	typedef SimdReal SimdMask;
+#elif (defined(__SSE2__) || defined(_M_X64)) && !defined(PHYSICS_NO_SIMD)
+	#include <emmintrin.h>
+	#ifdef PHYSICS_SINGLE_PRECISION
+		#define SIMD_LANES 4
+		#define SIMD_OP(op) _mm_##op##_ps
+		typedef __m128 SimdReal;
+	#else
+		#define SIMD_LANES 2
+		#define SIMD_OP(op) _mm_##op##_pd
+		typedef __m128d SimdReal;
+	#endif
+	#define SIMD_SSE
+	typedef SimdReal SimdMask;
+#else
+	#define SIMD_LANES 1
+	typedef real SimdReal;
+	typedef bool SimdMask;
+#endif
+
+// scalar lanes
+inline real simdLoad(const real *p, real) { return *p; }
+inline void simdStore(real *p, real a) { *p = a; }
+inline real simdSet(real a, real) { return a; }
+inline real simdAdd(real a, real b) { return a + b; }
+inline real simdSub(real a, real b) { return a - b; }
+inline real simdMul(real a, real b) { return a * b; }
+inline real simdDiv(real a, real b) { return a / b; }
+inline real simdSqrt(real a) { return real_sqrt(a); }
+inline real simdAbs(real a) { return real_abs(a); }
+inline real simdMin(real a, real b) { return a < b ? a : b; }
+inline real simdMax(real a, real b) { return a > b ? a : b; }
+inline bool simdLess(real a, real b) { return a < b; }
+inline bool simdGreater(real a, real b) { return a > b; }
+inline bool simdEqual(real a, real b) { return a == b; }
+inline bool simdAnd(bool a, bool b) { return a && b; }
+inline bool simdOr(bool a, bool b) { return a || b; }
+inline real simdSelect(bool mask, real a, real b) { return mask ? a : b; }
+inline int simdBits(bool mask) { return mask ? 1 : 0; }
+
+#if SIMD_LANES > 1
+	inline SimdReal simdLoad(const real *p, SimdReal) { return SIMD_OP(loadu)(p); }
+	inline void simdStore(real *p, SimdReal a) { SIMD_OP(storeu)(p, a); }
+	inline SimdReal simdSet(real a, SimdReal) { return SIMD_OP(set1)(a); }
+	inline SimdReal simdAdd(SimdReal a, SimdReal b) { return SIMD_OP(add)(a, b); }
+	inline SimdReal simdSub(SimdReal a, SimdReal b) { return SIMD_OP(sub)(a, b); }
+	inline SimdReal simdMul(SimdReal a, SimdReal b) { return SIMD_OP(mul)(a, b); }
+	inline SimdReal simdDiv(SimdReal a, SimdReal b) { return SIMD_OP(div)(a, b); }
+	inline SimdReal simdSqrt(SimdReal a) { return SIMD_OP(sqrt)(a); }
+	inline SimdReal simdAbs(SimdReal a) { return SIMD_OP(andnot)(SIMD_OP(set1)(-0.0f), a); }
+	inline SimdReal simdMin(SimdReal a, SimdReal b) { return SIMD_OP(min)(a, b); }
+	inline SimdReal simdMax(SimdReal a, SimdReal b) { return SIMD_OP(max)(a, b); }
+	inline SimdMask simdAnd(SimdMask a, SimdMask b) { return SIMD_OP(and)(a, b); }
+	inline SimdMask simdOr(SimdMask a, SimdMask b) { return SIMD_OP(or)(a, b); }
+	inline int simdBits(SimdMask mask) { return SIMD_OP(movemask)(mask); }
+#endif
+#ifdef SIMD_AVX
+	inline SimdMask simdLess(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a, b, _CMP_LT_OQ); }
+	inline SimdMask simdGreater(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a, b, _CMP_GT_OQ); }
+	inline SimdMask simdEqual(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a, b, _CMP_EQ_OQ); }
+	inline SimdReal simdSelect(SimdMask mask, SimdReal a, SimdReal b) { return SIMD_OP(blendv)(b, a, mask); }
+#endif
+#ifdef SIMD_SSE
+	inline SimdMask simdLess(SimdReal a, SimdReal b) { return SIMD_OP(cmplt)(a, b); }
+	inline SimdMask simdGreater(SimdReal a, SimdReal b) { return SIMD_OP(cmpgt)(a, b); }
+	inline SimdMask simdEqual(SimdReal a, SimdReal b) { return SIMD_OP(cmpeq)(a, b); }
+	inline SimdReal simdSelect(SimdMask mask, SimdReal a, SimdReal b)
+	{
+		return SIMD_OP(or)(SIMD_OP(and)(mask, a), SIMD_OP(andnot)(mask, b));
+	}
+#endif
+
+// nearest integer, exact for |a| < 2^51 (2^22 in single precision)
+template<class Lane>
+inline Lane simdRound(Lane a)
+{
+#ifdef PHYSICS_SINGLE_PRECISION
+	const real magic = (real)12582912.0; // 1.5 * 2^23
+#else
+	const real magic = (real)6755399441055744.0; // 1.5 * 2^52
+#endif
+	Lane m = simdSet(magic, a);
+	return simdSub(simdAdd(a, m), m);
+}
+
+// sine and cosine of every lane. The angle is reduced to [-pi/4, pi/4]
+// around the nearest quarter turn, where the Taylor series to the 15th
+// and 16th power are good to about 1e-16 (single precision rounding
+// long before); the quadrant then swaps and negates the results.
+template<class Lane>
+inline void simdSinCos(Lane angle, Lane &sine, Lane &cosine)
+{
+	const real twoOverPi = (real)0.63661977236758134308;
+#ifdef PHYSICS_SINGLE_PRECISION
+	const real halfPiHigh = (real)1.57079637050628662109; // pi/2 = high + low
+	const real halfPiLow = (real)-4.37113900018624283e-8;
+#else
+	const real halfPiHigh = (real)1.57079632679489655800; // pi/2 = high + low
+	const real halfPiLow = (real)6.12323399573676603587e-17;
+#endif
+
+	Lane quarter = simdRound(simdMul(angle, simdSet(twoOverPi, angle)));
+	Lane x = simdSub(angle, simdMul(quarter, simdSet(halfPiHigh, angle)));
+	x = simdSub(x, simdMul(quarter, simdSet(halfPiLow, angle)));
+	Lane x2 = simdMul(x, x);
+
+	// Horner on x^2
+	Lane s = simdSet((real)(1.0 / 1307674368000.0), x); // 1/15!
+	s = simdSub(simdSet((real)(1.0 / 6227020800.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)(1.0 / 39916800.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)(1.0 / 362880.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)(1.0 / 5040.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)(1.0 / 120.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)(1.0 / 6.0), x), simdMul(x2, s));
+	s = simdSub(simdSet((real)1.0, x), simdMul(x2, s));
+	s = simdMul(x, s);
+
+	Lane c = simdSet((real)(1.0 / 20922789888000.0), x); // 1/16!
+	c = simdSub(simdSet((real)(1.0 / 87178291200.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 479001600.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 3628800.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 40320.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 720.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 24.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)(1.0 / 2.0), x), simdMul(x2, c));
+	c = simdSub(simdSet((real)1.0, x), simdMul(x2, c));
+
+	// quadrant = quarter mod 4, here in [-2, 2]: odd ones swap sine and
+	// cosine, sine is negative in quadrants 2 and 3, cosine in 1 and 2
+	Lane q = simdSub(quarter, simdMul(simdSet((real)4.0, x),
+		simdRound(simdMul(quarter, simdSet((real)0.25, x)))));
+	Lane zero = simdSet((real)0.0, x);
+	Lane half = simdSet((real)0.5, x);
+	Lane oneHalf = simdSet((real)1.5, x);
+	Lane minusHalf = simdSet((real)-0.5, x);
+	Lane minusOneHalf = simdSet((real)-1.5, x);
+
+	Lane one = simdSet((real)1.0, x);
+	Lane swappedSine = simdSelect(simdEqual(simdAbs(q), one), c, s);
+	Lane swappedCosine = simdSelect(simdEqual(simdAbs(q), one), s, c);
+	sine = simdSelect(simdOr(simdGreater(q, oneHalf), simdLess(q, minusHalf)),
+		simdSub(zero, swappedSine), swappedSine);
+	cosine = simdSelect(simdOr(simdGreater(q, half), simdLess(q, minusOneHalf)),
+		simdSub(zero, swappedCosine), swappedCosine);
+}
+
+// allocator for the columns a kernel streams, so every block starts on a
+// cache line and the lanes never straddle one. The address malloc gave
+// is kept just below the aligned block.
+template<class T>
+struct SimdAllocator
+{
+	typedef T value_type;
+	static const size_t ALIGNMENT = 64;
+
+	SimdAllocator() {}
+	template<class U>
+	SimdAllocator(const SimdAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		char *raw = (char*)malloc(n * sizeof(T) + ALIGNMENT + sizeof(void*));
+		if (raw == NULL)
+			throw std::bad_alloc();
+		size_t address = (size_t)(raw + sizeof(void*));
+		char *aligned = (char*)((address + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+		((void**)aligned)[-1] = raw;
+		return (T*)aligned;
+	}
+
+	void deallocate(T *p, size_t)
+	{
+		free(((void**)p)[-1]);
+	}
+};
+
+template<class T, class U>
+inline bool operator==(const SimdAllocator<T>&, const SimdAllocator<U>&) { return true; }
+template<class T, class U>
+inline bool operator!=(const SimdAllocator<T>&, const SimdAllocator<U>&) { return false; }
+
+
+#endif // __SIMD_H_INCLUDED__
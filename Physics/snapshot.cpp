@@ -0,0 +1,76 @@
+#include "snapshot.h"
+#include "bodystore.h"
+#include "collide_fine.h"
+#include "stepper.h"
+
+BodySnapshot::BodySnapshot()
+{
+	tick = 0;
+	alpha = 0;
+}
+
+void BodySnapshot::keepPoses(const BodyStore &store)
+{
+	store.getPoses(previousPosition, previousOrientation);
+}
+
+void BodySnapshot::capture(const BodyStore &store, const CollisionData *contacts,
+	long long tick, real alpha, std::chrono::steady_clock::time_point time)
+{
+	store.getPoses(position, orientation);
+	isAwake = store.isAwake;
+
+	contactPoint.clear();
+	contactDepth.clear();
+	if (contacts != NULL)
+	{
+		for (int i = 0; i < contacts->contactsCount; i++)
+		{
+			const Contact &contact = contacts->contactArray[i];
+			contactPoint.push_back(contact.contactPoint);
+			contactDepth.push_back(contact.contactNormal * -contact.penetration);
+		}
+	}
+	this->tick = tick;
+	this->alpha = alpha;
+	this->time = time;
+}
+
+Matrix3 BodySnapshot::getTransform(unsigned slot, real alpha) const
+{
+	// slots created during the tick have nothing to blend from
+	if (slot >= previousPosition.size())
+	{
+		Matrix3 transform;
+		transform.setOrientationAndPos(orientation[slot], position[slot]);
+		return transform;
+	}
+	return FixedStepper::interpolate(previousPosition[slot], previousOrientation[slot],
+		position[slot], orientation[slot], alpha);
+}
+
+
+SnapshotBuffer::SnapshotBuffer()
+	: middle(1)
+{
+	back = 0;
+	front = 2;
+}
+
+BodySnapshot& SnapshotBuffer::getBack()
+{
+	return buffers[back];
+}
+
+void SnapshotBuffer::publish()
+{
+	// release the back buffer's contents with it
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+const BodySnapshot& SnapshotBuffer::acquire()
+{
+	if (middle.load(std::memory_order_relaxed) & FRESH)
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+	return buffers[front];
+}
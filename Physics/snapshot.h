@@ -0,0 +1,69 @@
+#ifndef __SNAPSHOT_H_INCLUDED__
+#define __SNAPSHOT_H_INCLUDED__
+
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+#include "precision.h"
+#include "core.h"
+
+class CollisionData;
+class BodyStore;
+
+// What a renderer needs of one completed tick, copied out of the
+// BodyStore so it can be drawn while the next tick runs: the pose and
+// awake flag of every slot, the poses before the tick to interpolate
+// from, and the contacts of the tick for display.
+struct BodySnapshot
+{
+	std::vector<Vector2> position; // by BodyStore slot
+	std::vector<Vector2> orientation;
+	std::vector<Vector2> previousPosition; // before the tick
+	std::vector<Vector2> previousOrientation;
+	std::vector<unsigned char> isAwake;
+	std::vector<Vector2> contactPoint;
+	std::vector<Vector2> contactDepth; // normal scaled by penetration, as drawn
+	long long tick; // ticks stepped when it was taken
+	real alpha; // the stepper's, at time
+	std::chrono::steady_clock::time_point time;
+
+	BodySnapshot();
+	// copies the poses before the tick; call before the last one
+	void keepPoses(const BodyStore &store);
+	// copies the store and, if given, the contacts
+	void capture(const BodyStore &store, const CollisionData *contacts, long long tick,
+		real alpha, std::chrono::steady_clock::time_point time);
+	// blended by alpha from before the tick to after it
+	Matrix3 getTransform(unsigned slot, real alpha) const;
+};
+
+// Lock-free triple buffer of snapshots between one writer and one
+// reader. The writer fills the back buffer and publishes it by swapping
+// it with the middle one; the reader swaps the middle one in as its
+// front buffer whenever a newer one was published, so neither ever
+// waits and the reader always has a whole snapshot.
+class SnapshotBuffer
+{
+protected:
+	static const int FRESH = 4; // middle holds a snapshot not read yet
+
+	BodySnapshot buffers[3];
+	std::atomic<int> middle; // buffer index, | FRESH
+	int back; // writer's
+	int front; // reader's
+
+public:
+	SnapshotBuffer();
+
+	// writer
+	BodySnapshot& getBack();
+	void publish();
+
+	// reader: the latest published snapshot
+	const BodySnapshot& acquire();
+};
+
+
+#endif // __SNAPSHOT_H_INCLUDED__
@@ -0,0 +1,174 @@
+#include <chrono>
+
+#include "stepper.h"
+#include "bodystore.h"
+
+FixedStepper::FixedStepper(real tick, int maxTicks)
+{
+	this->tick = tick;
+	this->maxTicks = maxTicks;
+	accumulator = 0;
+}
+
+int FixedStepper::advance(real frameTime)
+{
+	accumulator += frameTime;
+	int ticks = (int)(accumulator / tick);
+	if (ticks > maxTicks)
+		ticks = maxTicks;
+	accumulator -= ticks * tick;
+
+	// behind by more than maxTicks: drop the whole ticks, keep the part
+	if (accumulator >= tick)
+		accumulator -= (int)(accumulator / tick) * tick;
+	return ticks;
+}
+
+void FixedStepper::keepPoses(const BodyStore &store)
+{
+	store.getPoses(previousPosition, previousOrientation);
+}
+
+void FixedStepper::reset()
+{
+	accumulator = 0;
+	previousPosition.clear();
+	previousOrientation.clear();
+}
+
+Matrix3 FixedStepper::interpolate(const Vector2 &previousPosition,
+	const Vector2 &previousOrientation, const Vector2 &position,
+	const Vector2 &orientation, real alpha)
+{
+	Vector2 blendedOrientation = previousOrientation * (1 - alpha) + orientation * alpha;
+	if (blendedOrientation.squareMagnitude() == 0)
+		blendedOrientation = orientation;
+
+	Matrix3 transform;
+	transform.setOrientationAndPos(blendedOrientation,
+		previousPosition * (1 - alpha) + position * alpha);
+	return transform;
+}
+
+Matrix3 FixedStepper::getTransform(const BodyStore &store, unsigned slot) const
+{
+	if (slot >= previousPosition.size())
+		return store.transformMatrix[slot];
+	return interpolate(previousPosition[slot], previousOrientation[slot],
+		store.getPosition(slot), store.getOrientation(slot), getAlpha());
+}
+
+real FixedStepper::getTick() const
+{
+	return tick;
+}
+
+int FixedStepper::getMaxTicks() const
+{
+	return maxTicks;
+}
+
+real FixedStepper::getAlpha() const
+{
+	return accumulator / tick;
+}
+
+
+PhysicsThread::PhysicsThread(real tick, int maxTicks)
+	: stepper(tick, maxTicks), running(false)
+{
+	step = NULL;
+	data = NULL;
+	store = NULL;
+	contacts = NULL;
+	ticks = 0;
+}
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+void PhysicsThread::start(StepFunction step, void *data, const BodyStore &store,
+	const CollisionData *contacts)
+{
+	stop();
+	this->step = step;
+	this->data = data;
+	this->store = &store;
+	this->contacts = contacts;
+	ticks = 0;
+	stepper.reset();
+
+	// something to draw before the first tick
+	snapshots.getBack().keepPoses(store);
+	snapshots.getBack().capture(store, contacts, ticks, 0,
+		std::chrono::steady_clock::now());
+	snapshots.publish();
+
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&PhysicsThread::run, this);
+}
+
+void PhysicsThread::stop()
+{
+	if (!thread.joinable())
+		return;
+	running.store(false, std::memory_order_release);
+	thread.join();
+}
+
+void PhysicsThread::lock()
+{
+	mutex.lock();
+}
+
+void PhysicsThread::unlock()
+{
+	mutex.unlock();
+}
+
+const BodySnapshot& PhysicsThread::acquire()
+{
+	return snapshots.acquire();
+}
+
+real PhysicsThread::getAlpha(const BodySnapshot &snapshot) const
+{
+	real since = (real)std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - snapshot.time).count();
+	real alpha = snapshot.alpha + since / stepper.getTick();
+	return alpha < 1 ? alpha : 1;
+}
+
+void PhysicsThread::run()
+{
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+	while (running.load(std::memory_order_acquire))
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		int count = stepper.advance((real)std::chrono::duration<double>(now - last).count());
+		last = now;
+
+		if (count > 0)
+		{
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				BodySnapshot &snapshot = snapshots.getBack();
+				for (int i = 0; i < count; i++)
+				{
+					if (i == count - 1)
+						snapshot.keepPoses(*store);
+					step(data, stepper.getTick());
+				}
+				ticks += count;
+				snapshot.capture(*store, contacts, ticks, stepper.getAlpha(), now);
+			}
+			snapshots.publish();
+		}
+
+		// until the next tick is due
+		std::this_thread::sleep_for(std::chrono::duration<double>(
+			(1 - stepper.getAlpha()) * stepper.getTick()));
+	}
+}
@@ -0,0 +1,124 @@
+#ifndef __STEPPER_H_INCLUDED__
+#define __STEPPER_H_INCLUDED__
+
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include "precision.h"
+#include "core.h"
+#include "snapshot.h"
+#include "bodystore.h"
+
+// Fixed-timestep driver. Wall-clock frame times go into an accumulator
+// and come out as whole ticks of a fixed duration, so the cost and the
+// result of a step do not swing with the frame rate. After a long stall
+// at most maxTicks run and the rest of the backlog is dropped, so a slow
+// step cannot make the next frame slower still.
+//
+// What is left in the accumulator, as a fraction of a tick, is the alpha
+// to draw at. keepPoses before the last tick of a batch saves the poses
+// it starts from, and getTransform blends each body from there to its
+// current pose by alpha for drawing; the bodies themselves are never
+// moved, so the simulation does not depend on the frame rate.
+//
+//	int ticks = stepper.advance(frameTime);
+//	for (int i = 0; i < ticks; i++)
+//	{
+//		if (i == ticks - 1)
+//			stepper.keepPoses(store);
+//		app->update(stepper.getTick());
+//	}
+//	draw each body at stepper.getTransform(store, slot)
+class FixedStepper
+{
+protected:
+	real tick;
+	int maxTicks;
+	real accumulator;
+
+	// body poses before the last tick, by BodyStore slot
+	std::vector<Vector2> previousPosition;
+	std::vector<Vector2> previousOrientation;
+
+public:
+	FixedStepper(real tick = (real)1.0 / 60, int maxTicks = 4);
+
+	// the transform of the pose blended by alpha from previous to current;
+	// the current orientation if the blend cancels out
+	static Matrix3 interpolate(const Vector2 &previousPosition,
+		const Vector2 &previousOrientation, const Vector2 &position,
+		const Vector2 &orientation, real alpha);
+
+	// adds a frame's time and returns the ticks to run for it
+	int advance(real frameTime);
+	// keeps the poses before the last tick of a batch; the earlier ones
+	// are never drawn
+	void keepPoses(const BodyStore &store);
+	// forgets the backlog and the poses, e.g. when the scene changes
+	void reset();
+
+	// a slot's transform to draw at; slots created since keepPoses are
+	// drawn where they are
+	Matrix3 getTransform(const BodyStore &store, unsigned slot) const;
+
+	// accessor
+	real getTick() const;
+	int getMaxTicks() const;
+	real getAlpha() const; // accumulator / tick, in [0, 1)
+};
+
+// Steps a scene on a thread of its own at a FixedStepper's rate and
+// publishes a BodySnapshot after each batch of ticks through a
+// SnapshotBuffer, so the renderer draws the latest completed tick while
+// the next one runs instead of waiting for it. The snapshot keeps the
+// poses before the batch's last tick too, and getAlpha says how far to
+// blend from them for a frame drawn now.
+//
+// The step runs with the lock held. Other threads take it (lock/unlock)
+// before touching anything the step reads or writes, such as input
+// handlers applying impulses; drawing only reads the snapshot and takes
+// no lock. Bodies are only created or destroyed while it is stopped.
+class PhysicsThread
+{
+public:
+	typedef void (*StepFunction)(void *data, real duration);
+
+protected:
+	FixedStepper stepper;
+	StepFunction step;
+	void *data;
+	const BodyStore *store; // the stepped world's, copied into the snapshots
+	const CollisionData *contacts; // copied into the snapshots, may be NULL
+	long long ticks;
+
+	SnapshotBuffer snapshots;
+	std::thread thread;
+	std::mutex mutex;
+	std::atomic<bool> running;
+
+protected:
+	void run();
+
+public:
+	PhysicsThread(real tick = (real)1.0 / 60, int maxTicks = 4);
+	~PhysicsThread(); // stops
+
+	// publishes a snapshot of the current state, then steps on the thread
+	void start(StepFunction step, void *data, const BodyStore &store,
+		const CollisionData *contacts = NULL);
+	void stop(); // after the tick in progress
+	void lock();
+	void unlock();
+
+	// the latest completed tick, for one reading thread
+	const BodySnapshot& acquire();
+	// the stepper's alpha when the snapshot was taken plus the ticks
+	// since, at most 1 so drawing never runs ahead of the snapshot
+	real getAlpha(const BodySnapshot &snapshot) const;
+};
+
+
+#endif // __STEPPER_H_INCLUDED__
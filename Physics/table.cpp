@@ -0,0 +1,115 @@
+#include "table.h"
+
+HashTable::HashTable(int capacity)
+{
+	int size = 8;
+	while (size < capacity * 2)
+		size <<= 1;
+
+	Slot empty = { 0, 0, false };
+	slots.assign(size, empty);
+	count = 0;
+}
+
+int HashTable::slotOf(Key key) const
+{
+	// 64-bit finalizer from MurmurHash3
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (int)(key & (Key)(slots.size() - 1));
+}
+
+void HashTable::grow()
+{
+	std::vector<Slot> old;
+	old.swap(slots);
+
+	Slot empty = { 0, 0, false };
+	slots.assign(old.size() * 2, empty);
+	count = 0;
+
+	for (size_t i = 0; i < old.size(); i++)
+		if (old[i].used)
+			insert(old[i].key, old[i].value);
+}
+
+int HashTable::find(Key key) const
+{
+	int mask = (int)slots.size() - 1;
+	for (int i = slotOf(key); slots[i].used; i = (i + 1) & mask)
+		if (slots[i].key == key)
+			return slots[i].value;
+	return -1;
+}
+
+void HashTable::insert(Key key, int value)
+{
+	// keep the load factor under one half
+	if (2 * (count + 1) > (int)slots.size())
+		grow();
+
+	int mask = (int)slots.size() - 1;
+	int i = slotOf(key);
+	for (; slots[i].used; i = (i + 1) & mask)
+	{
+		if (slots[i].key == key)
+		{
+			slots[i].value = value;
+			return;
+		}
+	}
+
+	slots[i].key = key;
+	slots[i].value = value;
+	slots[i].used = true;
+	count++;
+}
+
+bool HashTable::remove(Key key)
+{
+	int mask = (int)slots.size() - 1;
+	int i = slotOf(key);
+	while (slots[i].used && slots[i].key != key)
+		i = (i + 1) & mask;
+	if (!slots[i].used)
+		return false;
+
+	// shift later entries of the probe run back into the hole
+	int hole = i;
+	for (int j = (i + 1) & mask; slots[j].used; j = (j + 1) & mask)
+	{
+		int home = slotOf(slots[j].key);
+		// move j into the hole unless its home lies cyclically in (hole, j]
+		bool between = (hole <= j) ? (hole < home && home <= j)
+			: (hole < home || home <= j);
+		if (!between)
+		{
+			slots[hole] = slots[j];
+			hole = j;
+		}
+	}
+
+	slots[hole].used = false;
+	count--;
+	return true;
+}
+
+void HashTable::clear()
+{
+	for (size_t i = 0; i < slots.size(); i++)
+		slots[i].used = false;
+	count = 0;
+}
+
+int HashTable::size() const
+{
+	return count;
+}
+
+HashTable::Key HashTable::makeKey(unsigned a, unsigned b)
+{
+	return ((Key)a << 32) | (Key)b;
+}
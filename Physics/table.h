@@ -0,0 +1,47 @@
+#ifndef __TABLE_H_INCLUDED__
+#define __TABLE_H_INCLUDED__
+
+
+#include <stddef.h>
+#include <vector>
+
+// Open-addressed hash table from 64-bit keys to ints (linear probing,
+// backward shift deletion, no tombstones). Used for sets of body or
+// object pairs that change a little every frame.
+class HashTable
+{
+public:
+	typedef unsigned long long Key;
+
+protected:
+	struct Slot
+	{
+		Key key;
+		int value;
+		bool used;
+	};
+
+	std::vector<Slot> slots; // size is a power of two
+	int count;
+
+protected:
+	int slotOf(Key key) const;
+	void grow();
+
+public:
+	HashTable(int capacity = 64);
+
+	// value stored for key, or -1
+	int find(Key key) const;
+	// inserts or overwrites
+	void insert(Key key, int value);
+	// returns false if key was not there
+	bool remove(Key key);
+	void clear();
+	int size() const;
+
+	static Key makeKey(unsigned a, unsigned b);
+};
+
+
+#endif // __TABLE_H_INCLUDED__
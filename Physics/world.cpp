@@ -1,3 +1,5 @@
+#include <assert.h>
+
 #include "world.h"
 
 World::World(int maxContacts, int iterations)
@@ -5,6 +7,7 @@ World::World(int maxContacts, int iterations)
 {
 	World::maxContacts = maxContacts;
 	contacts = new Contact[maxContacts];
+	usedContacts = 0;
 	calculateIterations = (iterations == 0);
 }
 
@@ -13,6 +16,11 @@ World::~World()
 	delete[] contacts;
 }
 
+BodyStore& World::getBodyStore()
+{
+	return store;
+}
+
 World::RigidBodies& World::getRigidBodies()
 {
 	return bodies;
@@ -28,6 +36,16 @@ ForceRegistry& World::getForceRegistry()
 	return registry;
 }
 
+ContactResolver& World::getResolver()
+{
+	return resolver;
+}
+
+int World::getUsedContacts() const
+{
+	return usedContacts;
+}
+
 void World::startFrame()
 {
 	RigidBodies::iterator i = bodies.begin();
@@ -49,7 +67,11 @@ int World::generateContacts()
 		if (limit <= 0)
 			break;
 
+		// the generator's position tells its contacts apart in the cache
 		int used = (*i)->addContact(nextContact, limit);
+		unsigned generator = (unsigned)(i - contactGenerators.begin());
+		for (int c = 0; c < used; c++)
+			nextContact[c].feature |= generator << 16;
 		limit -= used;
 		nextContact += used;
 	}
@@ -59,18 +81,59 @@ int World::generateContacts()
 
 void World::integrate(real duration)
 {
-	RigidBodies::iterator i = bodies.begin();
-	for (; i != bodies.end(); i++)
-		(*i)->integrate(duration);
+	// one pass over the store's columns instead of a call per body
+	bodySlots.resize(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		// a body of another world's store would integrate some other slot
+		assert(bodies[i]->getStore() == &store);
+		bodySlots[i] = bodies[i]->getHandle().index;
+	}
+	if (!bodySlots.empty())
+		store.integrate(&bodySlots[0], (int)bodySlots.size(), duration);
 }
 
 void World::runPhysics(real duration)
 {
-	registry.updateForces(duration);
-	integrate(duration);
-	int usedContacts = generateContacts();
+	PROFILE_FRAME();
+	{
+		PROFILE_SCOPE(PROFILE_UPDATE_FORCES);
+		registry.updateForces(duration);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_INTEGRATE);
+		integrate(duration);
+	}
+	{
+		PROFILE_SCOPE(PROFILE_WORLD_CONTACTS);
+		usedContacts = generateContacts();
+	}
 	//std::cout << usedContacts;
-	if (calculateIterations)
+	// the sequential impulse mode runs a fixed number of sweeps
+	if (calculateIterations && resolver.getMode() == RESOLVE_WORST_FIRST)
 		resolver.setIterations(usedContacts * 2, usedContacts * 2);
 	resolver.resolveContacts(contacts, usedContacts, duration);
-}
\ No newline at end of file
+}
+
+void World::updateSleep(const Contact *extraContacts, int extraCount)
+{
+	islands.clear();
+	RigidBodies::iterator i = bodies.begin();
+	for (; i != bodies.end(); i++)
+		islands.addBody(*i);
+	islands.addContacts(contacts, usedContacts);
+	if (extraContacts != NULL)
+		islands.addContacts(extraContacts, extraCount);
+	islands.build();
+	islands.updateSleep();
+}
+
+void World::setIslandSleep(bool islandSleep)
+{
+	store.setIslandSleep(islandSleep);
+}
+
+IslandGraph& World::getIslands()
+{
+	return islands;
+}
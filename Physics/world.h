@@ -9,6 +9,8 @@
 #include "body.h"
 #include "fgen.h"
 #include "contacts.h"
+#include "island.h"
+#include "profile.h"
 
 class World
 {
@@ -17,12 +19,16 @@ public:
 	typedef std::vector<ContactGenerator*> ContactGenerators;
 
 protected:
+	BodyStore store; // the state of the bodies created for this world
 	RigidBodies bodies;
 	ContactGenerators contactGenerators;
 	ForceRegistry registry;
 	ContactResolver resolver;
+	IslandGraph islands;
+	std::vector<unsigned> bodySlots; // BodyStore index of each body
 	Contact *contacts;
 	int maxContacts;
+	int usedContacts;
 	bool calculateIterations;
 
 public:
@@ -31,14 +37,24 @@ public:
 	~World();
 
 	// accesor
+	BodyStore& getBodyStore(); // create the world's bodies in it
 	RigidBodies& getRigidBodies();
 	ContactGenerators& getContactGenerators();
 	ForceRegistry& getForceRegistry();
+	ContactResolver& getResolver();
+	int getUsedContacts() const; // contacts generated in the last runPhysics
 
 	void startFrame();
 	int generateContacts();
 	void integrate(real duration);
 	void runPhysics(real duration);
+	// island sleep over all bodies, joined by the world's contacts of the
+	// last runPhysics and the extra ones given (contacts found outside
+	// the world); needs setIslandSleep(true)
+	void updateSleep(const Contact *extraContacts = NULL, int extraCount = 0);
+	// with true the world's bodies only sleep through updateSleep
+	void setIslandSleep(bool islandSleep);
+	IslandGraph& getIslands();
 };
 
 